@@ -1,11 +1,29 @@
 #ifndef C_UNIX_C
 #define C_UNIX_C
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#include "mmpolicy.h"
+
 #define PROT_READ     0x1
 #define PROT_WRITE    0x2
 #define PROT_EXEC     0x4
@@ -19,7 +37,7 @@ static void testFile() {
     printf("MMAP For Unix/Linux\n");
 }
 
-static void* mmap_file(const char* filename, size_t* length) {
+static void* mmap_file(const char* filename, size_t* length, int policy) {
     int fd = open(filename, O_RDONLY);
     if (fd == -1) {
         perror("Error opening file");
@@ -33,13 +51,37 @@ static void* mmap_file(const char* filename, size_t* length) {
         return MAP_FAILED;
     }
 
-    void* addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (policy & MM_POLICY_POPULATE) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    int protection = PROT_READ;
+    if (policy & MM_POLICY_WRITABLE) {
+        protection |= PROT_WRITE;
+    }
+
+    void* addr = mmap(NULL, file_size, protection, flags, fd, 0);
     if (addr == MAP_FAILED) {
         perror("Error mapping file to memory");
         close(fd);
         return MAP_FAILED;
     }
 
+    if (policy & MM_POLICY_SEQUENTIAL) {
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+    }
+    if (policy & MM_POLICY_WILLNEED) {
+        madvise(addr, file_size, MADV_WILLNEED);
+    }
+#ifdef MADV_HUGEPAGE
+    if (policy & MM_POLICY_HUGEPAGE) {
+        madvise(addr, file_size, MADV_HUGEPAGE);
+    }
+#endif
+
     *length = (size_t)file_size;
 
     close(fd);
@@ -50,4 +92,257 @@ static void munmap_file(void* addr, size_t length) {
     munmap(addr, length);
 }
 
+static void page_faults(size_t* minor, size_t* major) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    *minor = (size_t)usage.ru_minflt;
+    *major = (size_t)usage.ru_majflt;
+}
+
+/*
+* Drops the pages of an already consumed range. Only pages that end inside the range are dropped,
+* mapped pages are refetched from the file if touched again, read buffers come back zeroed.
+*/
+static void release_file_range(void* addr, size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (size_t)addr & ~(page - 1);
+    size_t end = ((size_t)addr + length) & ~(page - 1);
+    if (end > begin) {
+        madvise((void*)begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+/* Opens a file for the read backends, optionally bypassing the page cache */
+static intptr_t open_for_read(const char* filename, size_t* length, int direct) {
+    int flags = O_RDONLY;
+#ifdef O_DIRECT
+    if (direct) {
+        flags |= O_DIRECT;
+    }
+#endif
+    int fd = open(filename, flags);
+    if (fd == -1) {
+        perror("Error opening file");
+        return -1;
+    }
+
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    if (file_size == -1) {
+        perror("Error getting file size");
+        close(fd);
+        return -1;
+    }
+
+    *length = (size_t)file_size;
+    return fd;
+}
+
+static void close_file(intptr_t handle) {
+    if (handle != -1) {
+        close((int)handle);
+    }
+}
+
+/* Reads until length bytes are in or the file ends, returns the amount of bytes read */
+static size_t read_at(intptr_t handle, void* buffer, size_t length, size_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread((int)handle, (char*)buffer + done, length - done, (off_t)(offset + done));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        done += (size_t)got;
+    }
+    return done;
+}
+
+/* Page aligned anonymous memory the read backends fill, only touched pages take memory */
+static void* reserve_buffer(size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (length + page - 1) / page * page;
+    void* addr = mmap(NULL, size ? size : page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        perror("Error reserving read buffer");
+    }
+    return addr;
+}
+
+static void free_buffer(void* addr, size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (length + page - 1) / page * page;
+    munmap(addr, size ? size : page);
+}
+
+#ifdef HAVE_IO_URING
+
+struct uring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_len;
+    size_t cq_len;
+    size_t sqes_len;
+};
+
+static int uring_setup(struct uring* ring, unsigned depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) {
+            ring->sq_len = ring->cq_len;
+        }
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+    else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_len);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) {
+            munmap(ring->cq_ptr, ring->cq_len);
+        }
+        munmap(ring->sq_ptr, ring->sq_len);
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sq_head = (unsigned*)((char*)ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned*)((char*)ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)((char*)ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)((char*)ring->sq_ptr + params.sq_off.array);
+    ring->cq_head = (unsigned*)((char*)ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned*)((char*)ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)((char*)ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_ptr + params.cq_off.cqes);
+    return 0;
+}
+
+static void uring_teardown(struct uring* ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+}
+
+static void uring_queue_read(struct uring* ring, int fd, char* buffer, size_t length, size_t offset) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = (uint32_t)length;
+    sqe->off = offset;
+    sqe->user_data = offset;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+* Reads [offset, offset + length) of the file into buffer with up to depth reads of block bytes in flight.
+* Returns 0 on success and -1 when io_uring is unavailable or a read fails, the caller then falls back to pread.
+*/
+static int uring_read(intptr_t handle, char* buffer, size_t offset, size_t length, size_t block, unsigned depth) {
+    struct uring ring;
+    if (uring_setup(&ring, depth) != 0) {
+        return -1;
+    }
+
+    int fd = (int)handle;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t next = 0;
+    unsigned inFlight = 0;
+    unsigned toSubmit = 0;
+    int status = 0;
+
+    while ((next < length || inFlight > 0) && status == 0) {
+
+        while (next < length && inFlight < depth) {
+            size_t size = length - next < block ? length - next : block;
+            uring_queue_read(&ring, fd, buffer + next, size, offset + next);
+            next += size;
+            ++inFlight;
+            ++toSubmit;
+        }
+
+        if (syscall(__NR_io_uring_enter, ring.fd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = -1;
+            break;
+        }
+        toSubmit = 0;
+
+        unsigned head = *ring.cq_head;
+        while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            size_t done = cqe->user_data - offset;
+            size_t size = length - done < block ? length - done : block;
+            if (cqe->res < 0) {
+                status = -1;
+            }
+            else if ((size_t)cqe->res < size && cqe->res > 0) {
+                /* O_DIRECT only reads at block aligned offsets, the remainder restarts at the page it ends in */
+                size_t resume = (done + (size_t)cqe->res) / page * page;
+                read_at(handle, buffer + resume, done + size - resume, offset + resume);
+            }
+            --inFlight;
+            ++head;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    uring_teardown(&ring);
+    return status;
+}
+
+#else
+
+static int uring_read(intptr_t handle, char* buffer, size_t offset, size_t length, size_t block, unsigned depth) {
+    return -1;
+}
+
+#endif
+
 #endif
\ No newline at end of file
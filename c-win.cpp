@@ -2,15 +2,22 @@
 #define C_WIN_CPP
 
 #include <windows.h>
+#include <psapi.h>
 #include <iostream>
 #include <cstdint>
 
+#include "mmpolicy.h"
+
 void testFile() {
     std::cout << "MMAP For Windows" << std::endl;
 }
 
-void* mmap_file(const char* filename, size_t* length) {
-    HANDLE file_handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+void* mmap_file(const char* filename, size_t* length, int policy) {
+    DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+    if (policy & MM_POLICY_SEQUENTIAL) {
+        attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+    }
+    HANDLE file_handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, attributes, NULL);
     if (file_handle == INVALID_HANDLE_VALUE) {
         std::cerr << "Error opening file: " << GetLastError() << std::endl;
         return nullptr;
@@ -24,14 +31,15 @@ void* mmap_file(const char* filename, size_t* length) {
         return nullptr;
     }
 
-    HANDLE file_mapping = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    bool writable = policy & MM_POLICY_WRITABLE;
+    HANDLE file_mapping = CreateFileMapping(file_handle, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
     if (file_mapping == NULL) {
         std::cerr << "Error creating file mapping: " << GetLastError() << std::endl;
         CloseHandle(file_handle);
         return nullptr;
     }
 
-    void* mapped_addr = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    void* mapped_addr = MapViewOfFile(file_mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
     if (mapped_addr == NULL) {
         std::cerr << "Error mapping file: " << GetLastError() << std::endl;
         CloseHandle(file_mapping);
@@ -41,6 +49,11 @@ void* mmap_file(const char* filename, size_t* length) {
 
     *length = static_cast<size_t>(file_size);
 
+    if (policy & (MM_POLICY_WILLNEED | MM_POLICY_POPULATE)) {
+        WIN32_MEMORY_RANGE_ENTRY range{ mapped_addr, *length };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
     CloseHandle(file_mapping);
     CloseHandle(file_handle);
 
@@ -53,4 +66,80 @@ void munmap_file(void* addr) {
     }
 }
 
+/* Windows only reports the total, it is returned as minor faults */
+void page_faults(size_t* minor, size_t* major) {
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    *minor = static_cast<size_t>(counters.PageFaultCount);
+    *major = 0;
+}
+
+/* Unlocking pages that are not locked removes them from the working set */
+void release_file_range(void* addr, size_t length) {
+    VirtualUnlock(addr, length);
+}
+
+/* Opens a file for the read backends, optionally bypassing the file cache */
+intptr_t open_for_read(const char* filename, size_t* length, int direct) {
+    DWORD attributes = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+    if (direct) {
+        attributes |= FILE_FLAG_NO_BUFFERING;
+    }
+    HANDLE file_handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, attributes, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error opening file: " << GetLastError() << std::endl;
+        return -1;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        std::cerr << "Error getting file size: " << GetLastError() << std::endl;
+        CloseHandle(file_handle);
+        return -1;
+    }
+
+    *length = static_cast<size_t>(file_size.QuadPart);
+    return reinterpret_cast<intptr_t>(file_handle);
+}
+
+void close_file(intptr_t handle) {
+    if (handle != -1) {
+        CloseHandle(reinterpret_cast<HANDLE>(handle));
+    }
+}
+
+/* Reads until length bytes are in or the file ends, returns the amount of bytes read */
+size_t read_at(intptr_t handle, void* buffer, size_t length, size_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>((offset + done) & 0xFFFFFFFF);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD request = length - done > 0x40000000 ? 0x40000000 : static_cast<DWORD>(length - done);
+        DWORD got = 0;
+        if (!ReadFile(reinterpret_cast<HANDLE>(handle), static_cast<char*>(buffer) + done, request, &got, &overlapped) || got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+void* reserve_buffer(size_t length) {
+    void* addr = VirtualAlloc(NULL, length ? length : 1, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (addr == NULL) {
+        std::cerr << "Error reserving read buffer: " << GetLastError() << std::endl;
+    }
+    return addr;
+}
+
+void free_buffer(void* addr, size_t) {
+    VirtualFree(addr, 0, MEM_RELEASE);
+}
+
+/* There is no io_uring on Windows, the caller falls back to positioned reads */
+int uring_read(intptr_t, char*, size_t, size_t, size_t, unsigned) {
+    return -1;
+}
+
 #endif // C_WIN_CPP
@@ -9,6 +9,10 @@
 #include <string>
 #include <chrono>
 #include <sstream>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 class Timer
 {
@@ -39,13 +43,21 @@ static size_t amountOfThreads = std::thread::hardware_concurrency() - 1;
 
 void configureParser(cli::Parser& parser) {
 
-	parser.set_required<std::string>("f", "file", "filename", "filename to preprocess");
+	parser.set_required<std::string>("f", "file", "filename", "filename to preprocess. A comma separated list, a glob like data/*.csv or @list with one filename per line runs a batch");
 	parser.set_optional<std::string>("o", "output", "filename_output.csv", "output filename");
 
-    parser.set_optional<float>("g", "guess", 1.0f, "Sets a scalar to force the program to allocate more memory for the dataset");
-    parser.set_optional<size_t>("s", "sizet", 10, "How many % of dataset is analyzed for training");
+    parser.set_optional<size_t>("s", "sizet", 10, "How many % of dataset is analyzed for training at most");
+    parser.set_optional<double>("e", "tolerance", 0.01, "The analysis stops once doubling the sample changes no estimate by more than this, 0 analyzes all of -s");
+    parser.set_optional<double>("E", "budget", 1e-4, "Largest RMS error relative to the range of a column the automatic choice may introduce");
+    parser.set_optional<size_t>("R", "seed", 0, "Seed of the blocks drawn for the analysis sample");
 	parser.set_optional<size_t>("t", "threads", amountOfThreads, "Force to use amount of threads. Otherwise it will detect amount of logical cores.");
     parser.set_optional<size_t>("b", "bytes", 4096, "The amount of bytes scanned in the beginning, use large values if many columns");
+    parser.set_optional<size_t>("c", "chunk", 4096, "Size of a single parsing task in KiB, smaller chunks balance skewed files better");
+    parser.set_optional<std::string>("I", "ingest", "mmap", "How the file is read: mmap, pread or uring");
+    parser.set_optional<std::string>("i", "hints", "none", "Access hints for the input, comma separated: sequential,willneed,populate,hugepage for mmap, direct for pread and uring");
+    parser.set_optional<std::string>("P", "pin", "none", "Pins workers to cpus grouped by NUMA node: none, all or cores to use one hyperthread per core before the second ones");
+    parser.set_optional<bool>("H", "hugeblocks", false, "Backs the parsed values with 2 MiB transparent huge page blocks");
+    parser.set_optional<size_t>("A", "readahead", 0, "Distance in KiB a helper thread touches pages ahead of every parser, 0 disables it");
 	parser.set_optional<bool>("x", "xprint", false, "Prints all analysis results to the console");
 	parser.set_optional<std::string>("y", "yprint", "free.lunch", "Prints all logs to a file.");
 	parser.set_optional<bool>("z", "zprint", false, "Prints all logs to the console");
@@ -55,11 +67,25 @@ void configureParser(cli::Parser& parser) {
 	parser.set_optional<bool>("a", "add", false, "Forces addition scheme on the dataset");
 	parser.set_optional<bool>("p", "pow", false, "Forces power scheme on the dataset");
 
-    parser.set_optional<std::string>("w", "wparam", "3,12", "Sets the parameters for the multiplication scheme. Format M,P");
+    parser.set_optional<std::string>("w", "wparam", "3,12", "Sets the parameters for the multiplication scheme. Format M,P with P for float, shifted by 29 with -d");
+    parser.set_optional<size_t>("M", "maxm", 31, "Largest odd M the multiplication analysis searches, up to 255");
+
+    //binary input
+    parser.set_optional<std::string>("F", "format", "auto", "Input format: csv, f32, f64, npy or auto to decide by the file extension");
+    parser.set_optional<size_t>("C", "columns", 1, "Amount of columns of raw f32/f64 input");
+    parser.set_optional<bool>("d", "double", false, "Runs the pipeline in double precision, chosen automatically for f64 input");
+
+    //streaming
+    parser.set_optional<bool>("S", "stream", false, "Streams the file in windows instead of loading it, the scheme is analyzed on a sample from the beginning");
+    parser.set_optional<size_t>("r", "rss", 1024, "Memory budget in MB for the streaming mode");
+
+    //batch
+    parser.set_optional<bool>("O", "overlap", false, "In batch mode loads the next file while the current one is exported");
 
 }
 
-void handlePrinting(const cli::Parser& parser, Dataset *dataset) {
+template<typename T>
+void handlePrinting(const cli::Parser& parser, Dataset<T> *dataset) {
 
     if (parser.get<bool>("x")) {
         
@@ -80,7 +106,22 @@ void handlePrinting(const cli::Parser& parser, Dataset *dataset) {
 
 }
 
-void handleScheme(const cli::Parser& parser, Dataset * dataset) {
+template<typename T>
+void streamScheme(Dataset<T>* dataset, typename Dataset<T>::scheme scheme) {
+
+    dataset->selectedScheme = scheme;
+
+    size_t duration = 0;
+    {
+        Timer timer(&duration);
+        dataset->streamPreprocessedFile();
+    }
+    dataset->metrics.push_back(metric("Streamed apply and export", duration, dataset->file.length, "MB/s"));
+
+}
+
+template<typename T>
+void handleScheme(const cli::Parser& parser, Dataset<T> * dataset) {
     if (parser.get<bool>("m")) {
         
         std::istringstream iss(parser.get<std::string>("w"));
@@ -88,24 +129,33 @@ void handleScheme(const cli::Parser& parser, Dataset * dataset) {
         size_t m, p;
         char c;
         iss >> m >> c >> p;
+        /* P is given in float terms, double drops the same share of its longer mantissa */
+        p += floatTraits<T>::defaultP - floatTraits<float>::defaultP;
 
-        if (m % 2 == 1 && p < 32) {
+        if (floatTraits<T>::supportsM(m) && p > 0 && p < floatTraits<T>::width) {
             dataset->finalM = m;
             dataset->finalP = p;
         }
         else {
             dataset->finalM = 3;
-            dataset->finalP = 12;
+            dataset->finalP = floatTraits<T>::defaultP;
+        }
+
+        if (dataset->streaming) {
+            dataset->planColumns(Dataset<T>::multiplication);
+            streamScheme(dataset, Dataset<T>::multiplication);
+            return;
         }
 
         size_t duration = 0;
 		{
 			Timer timer(&duration);
 			
-            dataset->masterPerformMultiplication();
+            dataset->planColumns(Dataset<T>::multiplication);
+            dataset->masterApplyPlans();
 
         }
-        dataset->metrics.push_back(metric("Multiplication performace", duration, dataset->actualSize*4, "MB/s"));
+        dataset->metrics.push_back(metric("Multiplication performace", duration, dataset->actualSize*sizeof(T), "MB/s"));
 
         dataset->exportPreprocessedFile();
 
@@ -117,26 +167,40 @@ void handleScheme(const cli::Parser& parser, Dataset * dataset) {
             Timer timer(&duration);
             dataset->runAddition();
         }
-        dataset->metrics.push_back(metric("Analysis of addition", duration, dataset->howManyToTest*4, "MB/s"));
+        dataset->metrics.push_back(metric("Analysis of addition", duration, dataset->howManyToTest*sizeof(T), "MB/s"));
+        dataset->metrics.push_back(metric("Sampled values in " + std::to_string(dataset->analysisRounds) + " rounds", dataset->howManyToTest));
+        if (dataset->streaming) {
+            dataset->planColumns(Dataset<T>::addition);
+            streamScheme(dataset, Dataset<T>::addition);
+            return;
+        }
         duration = 0;
         {
             Timer timer(&duration);
-            dataset->masterPerformAddition();
+            dataset->planColumns(Dataset<T>::addition);
+            dataset->masterApplyPlans();
         }
-        dataset->metrics.push_back(metric("Addition performance", duration, dataset->actualSize*4, "MB/s"));
+        dataset->metrics.push_back(metric("Addition performance", duration, dataset->actualSize*sizeof(T), "MB/s"));
         dataset->exportPreprocessedFile();
     }
     else if (parser.get<bool>("p")) {
         
         dataset->finalPoFive = 25.0f;
 
+        if (dataset->streaming) {
+            dataset->planColumns(Dataset<T>::powersOfFive);
+            streamScheme(dataset, Dataset<T>::powersOfFive);
+            return;
+        }
+
         size_t duration = 0;
         {
             Timer timer(&duration);
 
-            dataset->masterPerformPowersOfFive();
+            dataset->planColumns(Dataset<T>::powersOfFive);
+            dataset->masterApplyPlans();
         }
-        dataset->metrics.push_back(metric("Powers of five performance", duration, dataset->actualSize*4, "MB/s"));
+        dataset->metrics.push_back(metric("Powers of five performance", duration, dataset->actualSize*sizeof(T), "MB/s"));
         dataset->exportPreprocessedFile();
     }
     else {
@@ -144,27 +208,315 @@ void handleScheme(const cli::Parser& parser, Dataset * dataset) {
 
         {
             Timer timer(&duration);
-            dataset->runAddition();
+            dataset->runAnalysis();
+            dataset->selectColumnPlans();
         }
 
-        dataset->metrics.push_back(metric("Analysis of addition", duration, dataset->howManyToTest*4, "MB/s"));
+        size_t multSize = dataset->multiplicationValues * sizeof(T);
+
+        /* one sweep over the sample, the per scheme entries are cpu time summed over the workers */
+        dataset->metrics.push_back(metric("Analysis", duration, dataset->howManyToTest*sizeof(T), "MB/s"));
+        dataset->metrics.push_back(metric(" - addition", dataset->additionMicros, dataset->howManyToTest*sizeof(T), "MB/s"));
+        dataset->metrics.push_back(metric(" - multiplication", dataset->multiplicationMicros, multSize, "MB/s"));
+        dataset->metrics.push_back(metric(" - powers of five", dataset->powersOfFiveMicros, dataset->howManyToTest*3*sizeof(T), "MB/s"));
+        dataset->metrics.push_back(metric("Sampled values in " + std::to_string(dataset->analysisRounds) + " rounds", dataset->howManyToTest));
+
+        /* every candidate is applied to the sample and compressed once */
+        size_t candidates = 0;
+        for (const auto& column : dataset->columnCandidates) {
+            candidates += column.size();
+        }
         duration = 0;
         {
             Timer timer(&duration);
-            dataset->runMultiplication();
+            dataset->estimateColumnPlans();
         }
+        dataset->metrics.push_back(metric("Compressibility estimate", duration, dataset->howManyToTest / std::max<size_t>(dataset->amountOfColumns, 1) * candidates * sizeof(T), "MB/s"));
 
-        size_t multSize = static_cast<size_t>(dataset->MValues.size()) * static_cast<size_t>(dataset->PValue.size()) * 4 * dataset->howManyToTest;
+        if (dataset->streaming) {
+            streamScheme(dataset, dataset->selectedScheme);
+            return;
+        }
 
-        dataset->metrics.push_back(metric("Analysis of multiplication", duration, multSize, "MB/s"));
         duration = 0;
         {
-            Timer tiomer(&duration);
-            dataset->runPowersOfFive();
+            Timer timer(&duration);
+            dataset->masterApplyPlans();
         }
-        dataset->metrics.push_back(metric("Analysis of Powers of five", duration, dataset->howManyToTest*12, "MB/s"));
-        
+        dataset->metrics.push_back(metric("Selected schemes performance", duration, dataset->actualSize*sizeof(T), "MB/s"));
+        dataset->exportPreprocessedFile();
+
+    }
+}
+
+/*
+* Maps, configures and loads one file. buffers, if given, hands the allocations of an earlier file
+* to the dataset before it is loaded. Returns nullptr if the input could not be loaded.
+*/
+template<typename T>
+std::unique_ptr<Dataset<T>> loadDataset(const cli::Parser& parser, threadPool& threadpool, const std::string& filename, batchBuffers<T>* buffers = nullptr) {
+
+    size_t minorFaults, majorFaults;
+    page_faults(&minorFaults, &majorFaults);
+
+    format format = detectFormat(filename, parser.get<std::string>("F"));
+    int policy = mmfile::parsePolicy(parser.get<std::string>("i"));
+    if (format != csv) {
+        policy |= MM_POLICY_WRITABLE;
+    }
+
+    auto dataset = std::make_unique<Dataset<T>>(filename, &threadpool, policy, mmfile::parseBackend(parser.get<std::string>("I")));
+    if (!dataset->file.isOpen()) {
+        std::cerr << "Unable to read " << filename << std::endl;
+        return nullptr;
+    }
+    if (buffers) {
+        dataset->swapBuffers(*buffers);
+    }
+    dataset->floatColumns.hugepage = parser.get<bool>("H");
+    dataset->inputFormat = format;
+    dataset->binaryColumns = parser.get<size_t>("C");
+    handlePrinting(parser, dataset.get());
+    dataset->defaultTestSizePercent = parser.get<size_t>("s");
+    dataset->sampleTolerance = parser.get<double>("e");
+    dataset->sampleSeed = parser.get<size_t>("R");
+    dataset->errorBudget = parser.get<double>("E");
+    dataset->maxMultiplier = parser.get<size_t>("M");
+    size_t duration { 0 };
+    dataset->bytesToCheck = parser.get<size_t>("b");
+    dataset->chunkBytes = parser.get<size_t>("c") * 1024;
+    dataset->streaming = parser.get<bool>("S");
+    dataset->rssBudget = parser.get<size_t>("r") * 1024 * 1024;
+    dataset->readaheadDistance = parser.get<size_t>("A") * 1024;
+    dataset->analyzeWhileParsing = !parser.get<bool>("m") && !parser.get<bool>("a") && !parser.get<bool>("p");
+
+    std::string accessPolicy = " [" + dataset->file.backendName() + "," + dataset->file.policyName() + (dataset->readaheadDistance ? ",readahead" : "") + "]";
+    if (format != csv) {
+        dataset->streaming = false;
+        bool loaded = false;
+        {
+            Timer timer(&duration);
+            loaded = dataset->loadBinary();
+        }
+        if (!loaded) {
+            return nullptr;
+        }
+        dataset->metrics.push_back(metric("Load of binary input" + accessPolicy, duration, dataset->file.length, "MB/s"));
+    }
+    else if (dataset->streaming) {
+        {
+            Timer timer(&duration);
+            dataset->parseHeaders();
+            dataset->loadSample();
+        }
+        dataset->metrics.push_back(metric("Load and casting of sample" + accessPolicy, duration, dataset->sampleBytes, "MB/s"));
+    }
+    else {
+        {
+            Timer timer(&duration);
+            dataset->parseHeaders();
+            dataset->startCastingProcess();
+
+        }
+        dataset->metrics.push_back(metric("Load and casting" + accessPolicy, duration, dataset->file.length, "MB/s"));
+    }
+
+    for (size_t kind = performanceCore; kind < coreKinds; ++kind) {
+        if (dataset->castMicros[kind]) {
+            dataset->metrics.push_back(metric(std::string("Casting per ") + coreKindName(static_cast<int>(kind)) + " core", dataset->castMicros[kind], dataset->castBytes[kind], "MB/s"));
+        }
+    }
+
+    size_t minorAfterLoad, majorAfterLoad;
+    page_faults(&minorAfterLoad, &majorAfterLoad);
+    dataset->metrics.push_back(metric("Minor page faults of load", minorAfterLoad - minorFaults));
+    dataset->metrics.push_back(metric("Major page faults of load", majorAfterLoad - majorFaults));
+
+    return dataset;
+}
+
+template<typename T>
+void runDataset(const cli::Parser& parser, threadPool& threadpool) {
+
+    std::unique_ptr<Dataset<T>> dataset = loadDataset<T>(parser, threadpool, parser.get<std::string>("f"));
+    if (!dataset) {
+        return;
+    }
+    {
+        handleScheme(parser, dataset.get());
     }
+
+}
+
+/* Matches a filename against a pattern with * and ? wildcards */
+static bool matchesGlob(const char* pattern, const char* name) {
+    if (*pattern == '\0') {
+        return *name == '\0';
+    }
+    if (*pattern == '*') {
+        return matchesGlob(pattern + 1, name) || (*name != '\0' && matchesGlob(pattern, name + 1));
+    }
+    if (*name != '\0' && (*pattern == '?' || *pattern == *name)) {
+        return matchesGlob(pattern + 1, name + 1);
+    }
+    return false;
+}
+
+/*
+* Expands the -f value into the input files, wildcards are only allowed in the filename part.
+* Outputs of an earlier batch (preprocessed_*) are not matched by a wildcard.
+*/
+std::vector<std::string> expandInputs(const std::string& value) {
+
+    namespace fs = std::filesystem;
+    std::vector<std::string> inputs;
+    std::vector<std::string> entries;
+
+    if (!value.empty() && value[0] == '@') {
+        std::ifstream list(value.substr(1));
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                entries.push_back(line);
+            }
+        }
+    }
+    else {
+        std::istringstream iss(value);
+        std::string entry;
+        while (std::getline(iss, entry, ',')) {
+            if (!entry.empty()) {
+                entries.push_back(entry);
+            }
+        }
+    }
+
+    for (const auto& entry : entries) {
+
+        if (entry.find_first_of("*?") == std::string::npos) {
+            inputs.push_back(entry);
+            continue;
+        }
+
+        fs::path path(entry);
+        fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+        std::string pattern = path.filename().string();
+        std::vector<std::string> matches;
+        std::error_code ec;
+        for (const auto& file : fs::directory_iterator(directory, ec)) {
+            std::string name = file.path().filename().string();
+            if (file.is_regular_file() && name.rfind("preprocessed_", 0) != 0 && matchesGlob(pattern.c_str(), name.c_str())) {
+                matches.push_back(path.has_parent_path() ? file.path().string() : name);
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        inputs.insert(inputs.end(), matches.begin(), matches.end());
+    }
+
+    return inputs;
+}
+
+/* One row of the batch summary */
+struct batchResult {
+    std::string filename;
+    size_t rows;
+    size_t bytes;
+    size_t loadDuration;
+    size_t exportDuration;
+};
+
+/*
+* Runs every input through one pool. The columns and the export buffer of a finished file are
+* handed to the next one, with -O two sets alternate so file N+1 loads while file N is exported.
+* Every file writes preprocessed_<name>.csv.
+*/
+template<typename T>
+void runBatch(const cli::Parser& parser, threadPool& threadpool, const std::vector<std::string>& inputs) {
+
+    bool overlap = parser.get<bool>("O");
+    batchBuffers<T> buffers[2];
+    std::vector<batchResult> results(inputs.size());
+
+    std::unique_ptr<Dataset<T>> exporting;
+    size_t exportingIdx = 0;
+    std::thread exporter;
+
+    auto finish = [&]() {
+        if (exporter.joinable()) {
+            exporter.join();
+        }
+        if (exporting) {
+            exporting->swapBuffers(buffers[exportingIdx % 2]);
+            exporting.reset();
+        }
+    };
+
+    size_t total = 0;
+    {
+        Timer timer(&total);
+
+        for (size_t i = 0; i < inputs.size(); ++i) {
+
+            batchBuffers<T>* recycled = &buffers[overlap ? i % 2 : 0];
+            std::unique_ptr<Dataset<T>> dataset;
+            {
+                Timer loadTimer(&results[i].loadDuration);
+                dataset = loadDataset<T>(parser, threadpool, inputs[i], recycled);
+            }
+            results[i].filename = inputs[i];
+            results[i].bytes = 0;
+            results[i].rows = 0;
+            results[i].exportDuration = 0;
+
+            finish();
+
+            if (!dataset) {
+                continue;
+            }
+            results[i].bytes = dataset->file.length;
+            results[i].rows = dataset->amountOfColumns ? dataset->actualSize / dataset->amountOfColumns : 0;
+            dataset->outputFilename = "preprocessed_" + std::filesystem::path(inputs[i]).stem().string() + ".csv";
+
+            exporting = std::move(dataset);
+            exportingIdx = overlap ? i : 0;
+            Dataset<T>* current = exporting.get();
+            size_t* exportDuration = &results[i].exportDuration;
+            auto work = [&parser, current, exportDuration]() {
+                Timer exportTimer(exportDuration);
+                handleScheme(parser, current);
+            };
+
+            if (overlap) {
+                exporter = std::thread(work);
+            }
+            else {
+                work();
+                finish();
+            }
+        }
+
+        finish();
+    }
+
+    Table batchTable;
+    batchTable.add_row({ "File", "Rows", "Size", "Load", "Export", "Throughput" });
+    batchTable.format().column_separator("");
+
+    size_t bytes = 0;
+    size_t rows = 0;
+    for (const auto& result : results) {
+        metric row(result.filename, result.loadDuration + result.exportDuration, result.bytes, "MB/s");
+        batchTable.add_row({ result.filename, std::to_string(result.rows), std::to_string(result.bytes), std::to_string(result.loadDuration / 1000), std::to_string(result.exportDuration / 1000), std::to_string(row.throughput) + row.unit });
+        bytes += result.bytes;
+        rows += result.rows;
+    }
+    metric aggregate("Total", total, bytes, "MB/s");
+    batchTable.add_row({ aggregate.name + " (" + std::to_string(inputs.size()) + " files)", std::to_string(rows), std::to_string(bytes), "", std::to_string(aggregate.duration), std::to_string(aggregate.throughput) + aggregate.unit });
+
+    std::cout << "\n" << batchTable << std::endl;
 }
 
 void runParser(const cli::Parser& parser) {
@@ -177,27 +529,34 @@ void runParser(const cli::Parser& parser) {
     }
 
     threadPool threadpool(amountOfThreads);
+    std::string pinning = parser.get<std::string>("P");
+    if (pinning == "all" || pinning == "cores") {
+        threadpool.pin(placementOrder(readTopology(), pinning == "cores"));
+    }
     threadpool.start();
 
-    Dataset dataset(parser.get<std::string>("f"), &threadpool);
-    handlePrinting(parser, &dataset);
-    dataset.guessScaling = parser.get<float>("g");
-    dataset.defaultTestSizePercent = parser.get<size_t>("s");
-    size_t duration { 0 };
-    dataset.bytesToCheck = parser.get<size_t>("b");
-    {
-        Timer timer(&duration);
-        dataset.parseHeaders();
-        dataset.guessDatasetSize();
-        dataset.startCastingProcess();
+    std::vector<std::string> inputs = expandInputs(parser.get<std::string>("f"));
+    if (inputs.empty()) {
+        std::cerr << "No input files match " << parser.get<std::string>("f") << std::endl;
+        return;
+    }
+    bool batch = inputs.size() > 1 || inputs[0] != parser.get<std::string>("f");
+
+    format format = detectFormat(inputs[0], parser.get<std::string>("F"));
+    bool useDouble = parser.get<bool>("d") || formatElementSize(inputs[0], format) == sizeof(double);
 
+    if (batch && useDouble) {
+        runBatch<double>(parser, threadpool, inputs);
     }
-    dataset.metrics.push_back(metric("Load and casting", duration, dataset.file.length, "MB/s"));
-    {
-        handleScheme(parser, &dataset);
+    else if (batch) {
+        runBatch<float>(parser, threadpool, inputs);
+    }
+    else if (useDouble) {
+        runDataset<double>(parser, threadpool);
+    }
+    else {
+        runDataset<float>(parser, threadpool);
     }
-
-    
 
 }
 
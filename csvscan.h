@@ -0,0 +1,334 @@
+#ifndef CSVSCAN_H
+#define CSVSCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <cstring>
+#include <unordered_map>
+
+#include "fast_float.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+/*
+* blankLines are the line breaks right after another one or at begin, and with crlf also those after a \r
+* that directly follows one, the parser skips them instead of reading a row
+*/
+struct symbolCount {
+	size_t lines = 0;
+	size_t delimiters = 0;
+	size_t quotes = 0;
+	size_t blankLines = 0;
+};
+
+/*
+* Line breaks of a block that end a blank line. lineCarry holds the line breaks of the two bytes before
+* the block in bits 1 and 0, crCarry the \r of the byte before it.
+*/
+template<typename M>
+inline M blankLineMask(M lines, M carriages, M lineCarry, M crCarry) {
+	M afterLine = lines << 1 | lineCarry >> 1;
+	M afterBlankCr = (carriages << 1 | crCarry) & (lines << 2 | lineCarry);
+	return lines & (afterLine | afterBlankCr);
+}
+
+/* Counts line breaks and delimiters in [begin, end), 32 or 16 bytes per step */
+inline symbolCount countSymbols(const char* begin, const char* end, char lineBreak, char delimiter, bool crlf) {
+
+	symbolCount count;
+	const char* p = begin;
+	uint32_t lineCarry = 2;
+	uint32_t crCarry = 0;
+
+#if defined(__AVX2__)
+	const __m256i lineBreaks = _mm256_set1_epi8(lineBreak);
+	const __m256i delimiters = _mm256_set1_epi8(delimiter);
+	const __m256i carriages = _mm256_set1_epi8('\r');
+
+	for (; p + 32 <= end; p += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t lineMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lineBreaks)));
+		uint32_t delimiterMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, delimiters)));
+		uint32_t crMask = crlf ? static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, carriages))) : 0;
+		count.lines += std::popcount(lineMask);
+		count.delimiters += std::popcount(delimiterMask);
+		count.blankLines += std::popcount(blankLineMask(lineMask, crMask, lineCarry, crCarry));
+		lineCarry = lineMask >> 30;
+		crCarry = crMask >> 31;
+	}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128i lineBreaks16 = _mm_set1_epi8(lineBreak);
+	const __m128i delimiters16 = _mm_set1_epi8(delimiter);
+	const __m128i carriages16 = _mm_set1_epi8('\r');
+
+	for (; p + 16 <= end; p += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t lineMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lineBreaks16)));
+		uint32_t delimiterMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, delimiters16)));
+		uint32_t crMask = crlf ? static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, carriages16))) : 0;
+		count.lines += std::popcount(lineMask);
+		count.delimiters += std::popcount(delimiterMask);
+		count.blankLines += std::popcount(blankLineMask(lineMask, crMask, lineCarry, crCarry));
+		lineCarry = lineMask >> 14;
+		crCarry = crMask >> 15;
+	}
+#endif
+
+	for (; p < end; ++p) {
+		uint32_t line = *p == lineBreak;
+		uint32_t cr = crlf && *p == '\r';
+		count.lines += line;
+		count.delimiters += *p == delimiter;
+		count.blankLines += blankLineMask(line, cr, lineCarry, crCarry) & 1;
+		lineCarry = line << 1 | lineCarry >> 1;
+		crCarry = cr;
+	}
+
+	return count;
+}
+
+/* Bit i is set if p[i] == symbol, for the 64 bytes starting at p */
+inline uint64_t symbolMask(const char* p, char symbol) {
+
+#if defined(__AVX512BW__)
+	return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p), _mm512_set1_epi8(symbol));
+#elif defined(__AVX2__)
+	const __m256i symbols = _mm256_set1_epi8(symbol);
+	uint32_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), symbols)));
+	uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), symbols)));
+	return static_cast<uint64_t>(high) << 32 | low;
+#elif defined(__SSE2__) || defined(_M_X64)
+	const __m128i symbols = _mm_set1_epi8(symbol);
+	uint64_t mask = 0;
+	for (int i = 0; i < 4; ++i) {
+		uint32_t part = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i)), symbols)));
+		mask |= static_cast<uint64_t>(part) << (16 * i);
+	}
+	return mask;
+#else
+	uint64_t mask = 0;
+	for (int i = 0; i < 64; ++i) {
+		mask |= static_cast<uint64_t>(p[i] == symbol) << i;
+	}
+	return mask;
+#endif
+}
+
+/*
+* Prefix XOR of the quote bits: bit i is set if an odd amount of quotes is at or before i,
+* i.e. byte i is inside a quoted field. A carry-less multiplication by all ones computes it in one step.
+*/
+inline uint64_t prefixXor(uint64_t quotes) {
+
+#if defined(__PCLMUL__)
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(quotes)), _mm_set1_epi8(-1), 0)));
+#else
+	quotes ^= quotes << 1;
+	quotes ^= quotes << 2;
+	quotes ^= quotes << 4;
+	quotes ^= quotes << 8;
+	quotes ^= quotes << 16;
+	quotes ^= quotes << 32;
+	return quotes;
+#endif
+}
+
+/*
+* Counts the line breaks and delimiters outside of quotes in [begin, end) 64 bytes per step,
+* begin has to be outside of quotes. quotes is the total amount of quote characters,
+* blankLines counts like countSymbols with the line breaks and \r outside of quotes.
+*/
+inline symbolCount countQuotedSymbols(const char* begin, const char* end, char lineBreak, char delimiter, char quote, bool crlf) {
+
+	symbolCount count;
+	const char* p = begin;
+	uint64_t carry = 0;
+	uint64_t lineCarry = 2;
+	uint64_t crCarry = 0;
+
+	for (; p + 64 <= end; p += 64) {
+		uint64_t quotes = symbolMask(p, quote);
+		uint64_t inside = prefixXor(quotes) ^ carry;
+		carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+		uint64_t lines = symbolMask(p, lineBreak) & ~inside;
+		uint64_t carriages = crlf ? symbolMask(p, '\r') & ~inside : 0;
+		count.lines += std::popcount(lines);
+		count.delimiters += std::popcount(symbolMask(p, delimiter) & ~inside);
+		count.quotes += std::popcount(quotes);
+		count.blankLines += std::popcount(blankLineMask(lines, carriages, lineCarry, crCarry));
+		lineCarry = lines >> 62;
+		crCarry = carriages >> 63;
+	}
+
+	bool quoted = carry != 0;
+	for (; p < end; ++p) {
+		uint64_t line = 0;
+		uint64_t cr = 0;
+		if (*p == quote) {
+			quoted = !quoted;
+			++count.quotes;
+		}
+		else if (!quoted) {
+			line = *p == lineBreak;
+			cr = crlf && *p == '\r';
+			count.lines += line;
+			count.delimiters += *p == delimiter;
+		}
+		count.blankLines += blankLineMask(line, cr, lineCarry, crCarry) & 1;
+		lineCarry = line << 1 | lineCarry >> 1;
+		crCarry = cr;
+	}
+
+	return count;
+}
+
+/* Candidate delimiters in order of preference when several fit equally well */
+static constexpr char dialectDelimiters[] = { ',', ';', '\t', '|', ' ' };
+static constexpr size_t dialectCandidates = sizeof(dialectDelimiters);
+
+/* Counts every candidate delimiter in [begin, end), all candidates are compared against the same block */
+inline void countCandidates(const char* begin, const char* end, size_t* counts) {
+
+	const char* p = begin;
+
+	for (size_t k = 0; k < dialectCandidates; ++k) {
+		counts[k] = 0;
+	}
+
+#if defined(__AVX2__)
+	for (; p + 32 <= end; p += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		for (size_t k = 0; k < dialectCandidates; ++k) {
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(dialectDelimiters[k]))));
+			counts[k] += std::popcount(mask);
+		}
+	}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+	for (; p + 16 <= end; p += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		for (size_t k = 0; k < dialectCandidates; ++k) {
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(dialectDelimiters[k]))));
+			counts[k] += std::popcount(mask);
+		}
+	}
+#endif
+
+	for (; p < end; ++p) {
+		for (size_t k = 0; k < dialectCandidates; ++k) {
+			counts[k] += *p == dialectDelimiters[k];
+		}
+	}
+}
+
+struct csvDialect {
+	char delimiter = ',';
+	char lineBreak = '\n';
+	bool crlf = false;
+	bool header = true;
+	bool quoted = false;
+};
+
+/* True if every field of the row parses completely as a number, empty fields count as missing values */
+inline bool numericRow(const char* begin, const char* end, char delimiter) {
+
+	while (begin <= end) {
+
+		const char* fieldEnd = static_cast<const char*>(std::memchr(begin, delimiter, end - begin));
+		if (fieldEnd == nullptr) {
+			fieldEnd = end;
+		}
+
+		const char* first = begin;
+		const char* last = fieldEnd;
+		while (first < last && (*first == ' ' || *first == '"')) {
+			++first;
+		}
+		while (last > first && (last[-1] == ' ' || last[-1] == '"' || last[-1] == '\r')) {
+			--last;
+		}
+		if (first < last) {
+			double value;
+			fast_float::from_chars_result result = fast_float::from_chars(first, last, value);
+			if (result.ec != std::errc() || result.ptr != last) {
+				return false;
+			}
+		}
+
+		begin = fieldEnd + 1;
+	}
+
+	return true;
+}
+
+/*
+* Guesses the dialect from the complete lines in [begin, end).
+* The line ending is \n, \r\n or a lone \r. The delimiter is the candidate that occurs the same
+* nonzero amount of times on the most lines, and the first line is a header unless it is numeric.
+*/
+inline csvDialect sniffDialect(const char* begin, const char* end) {
+
+	csvDialect dialect;
+
+	const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+	const char* carriage = static_cast<const char*>(std::memchr(begin, '\r', end - begin));
+	if (newline == nullptr && carriage != nullptr) {
+		dialect.lineBreak = '\r';
+	}
+	else if (newline != nullptr && newline > begin && newline[-1] == '\r') {
+		dialect.crlf = true;
+	}
+
+	dialect.quoted = std::memchr(begin, '"', end - begin) != nullptr;
+
+	/* Per candidate how many lines have each count, so the vote is linear in the lines scanned */
+	std::unordered_map<size_t, size_t> histograms[dialectCandidates];
+	size_t counts[dialectCandidates];
+	const char* firstLine = nullptr;
+	const char* line = begin;
+	while (line < end) {
+		const char* lineEnd = static_cast<const char*>(std::memchr(line, dialect.lineBreak, end - line));
+		if (lineEnd == nullptr) {
+			break;
+		}
+		if (lineEnd > line + dialect.crlf) {
+			countCandidates(line, lineEnd, counts);
+			for (size_t k = 0; k < dialectCandidates; ++k) {
+				++histograms[k][counts[k]];
+			}
+			if (firstLine == nullptr) {
+				firstLine = line;
+			}
+		}
+		line = lineEnd + 1;
+	}
+	if (firstLine == nullptr) {
+		firstLine = begin;
+		countCandidates(begin, end, counts);
+		for (size_t k = 0; k < dialectCandidates; ++k) {
+			++histograms[k][counts[k]];
+		}
+	}
+
+	/* Lines that agree with the most frequent nonzero count of every candidate */
+	size_t bestAgreement = 0;
+	for (size_t k = 0; k < dialectCandidates; ++k) {
+		for (const auto& [count, agreement] : histograms[k]) {
+			if (count != 0 && agreement > bestAgreement) {
+				bestAgreement = agreement;
+				dialect.delimiter = dialectDelimiters[k];
+			}
+		}
+	}
+
+	const char* firstEnd = static_cast<const char*>(std::memchr(firstLine, dialect.lineBreak, end - firstLine));
+	dialect.header = !numericRow(firstLine, firstEnd ? firstEnd : end, dialect.delimiter);
+
+	return dialect;
+}
+
+#endif // !CSVSCAN_H
@@ -0,0 +1,117 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#include <immintrin.h>
+#define DECIMAL_SIMD 1
+#endif
+
+/* Limits of the exact fast path: mantissa and power of ten are both exactly representable in T */
+template<typename T>
+struct decimalLimits;
+
+template<>
+struct decimalLimits<float> {
+	static constexpr uint64_t maxMantissa = uint64_t(1) << 24;
+	static constexpr int maxFraction = 10;
+};
+
+template<>
+struct decimalLimits<double> {
+	static constexpr uint64_t maxMantissa = uint64_t(1) << 53;
+	static constexpr int maxFraction = 22;
+};
+
+template<typename T>
+inline T exactPowerOfTen(int k) {
+	static constexpr double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	return static_cast<T>(powers[k]);
+}
+
+/*
+* Parses a fixed format decimal like -12.3456 from the 16 bytes at ptr in one pass: the digits are
+* located with a vector compare, gathered without the dot into the low end of a register and reduced
+* to an integer by multiply-adds. The number has to be followed by the delimiter, the line break,
+* \r or a quote. Returns the end of the number, or nullptr if the field has another shape (exponent,
+* more than 16 digits, a mantissa or fraction outside of the exact range of T) or fewer than 16 bytes
+* are left, the caller then parses it with fast_float. Both give the correctly rounded value.
+*/
+template<typename T>
+inline const char* parseFixedDecimal(const char* ptr, const char* end, char delimiter, char lineBreak, T& value) {
+
+#ifdef DECIMAL_SIMD
+	if (end - ptr < 16) {
+		return nullptr;
+	}
+
+	const __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+	const __m128i digits = _mm_sub_epi8(text, _mm_set1_epi8('0'));
+	/* unsigned digits < 10, as signed compare after flipping the sign bit */
+	const __m128i isDigit = _mm_cmplt_epi8(_mm_xor_si128(digits, _mm_set1_epi8(-128)), _mm_set1_epi8(-128 + 10));
+	uint32_t digitMask = static_cast<uint32_t>(_mm_movemask_epi8(isDigit));
+
+	int sign = ptr[0] == '-';
+	uint32_t shifted = ~(digitMask >> sign);
+	int integerDigits = std::countr_zero(shifted);
+	if (integerDigits == 0) {
+		return nullptr;
+	}
+
+	int position = sign + integerDigits;
+	int fractionDigits = 0;
+	if (position < 16 && ptr[position] == '.') {
+		fractionDigits = std::countr_zero(~(digitMask >> (position + 1)));
+		position += 1 + fractionDigits;
+	}
+	if (position >= 16) {
+		return nullptr;
+	}
+
+	char next = ptr[position];
+	if (next != delimiter && next != lineBreak && next != '\r' && next != '"') {
+		return nullptr;
+	}
+
+	int count = integerDigits + fractionDigits;
+	if (count > 16 || fractionDigits > decimalLimits<T>::maxFraction) {
+		return nullptr;
+	}
+
+	/* lane j takes digit d = j - (16 - count), which sits at sign + d, one further after the dot */
+	const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i digit = _mm_sub_epi8(lanes, _mm_set1_epi8(static_cast<char>(16 - count)));
+	const __m128i afterDot = _mm_cmpgt_epi8(digit, _mm_set1_epi8(static_cast<char>(integerDigits - 1)));
+	__m128i source = _mm_add_epi8(digit, _mm_set1_epi8(static_cast<char>(sign)));
+	source = _mm_sub_epi8(source, afterDot);
+	source = _mm_or_si128(source, _mm_cmplt_epi8(digit, _mm_setzero_si128()));
+	const __m128i aligned = _mm_shuffle_epi8(digits, source);
+
+	const __m128i pairs = _mm_maddubs_epi16(aligned, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+	const __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+	const __m128i packed = _mm_packus_epi32(quads, quads);
+	const __m128i octs = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 0, 0, 0, 0));
+	uint64_t mantissa = static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(octs))) * 100000000
+		+ static_cast<uint32_t>(_mm_extract_epi32(octs, 1));
+
+	if (mantissa > decimalLimits<T>::maxMantissa) {
+		return nullptr;
+	}
+
+	T result = static_cast<T>(mantissa);
+	if (fractionDigits) {
+		result = result / exactPowerOfTen<T>(fractionDigits);
+	}
+	value = sign ? -result : result;
+	return ptr + position;
+#else
+	(void)ptr; (void)end; (void)delimiter; (void)lineBreak; (void)value;
+	return nullptr;
+#endif
+}
+
+#endif // !DECIMAL_H
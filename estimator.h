@@ -0,0 +1,278 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+* Counts of a block of Width bit values that predict its size on disk: the byte histogram gives the
+* order-0 entropy, the ones per bit position the entropy of the bit planes, compressedBytes is the
+* size lzCompressedSize reached. Counts of several blocks are added, the entropies are derived at the end.
+*/
+template<size_t Width>
+struct compressibility {
+	size_t values = 0;
+	size_t compressedBytes = 0;
+	size_t byteCounts[256] = {};
+	size_t ones[Width] = {};
+
+	void add(const compressibility& other) {
+		values += other.values;
+		compressedBytes += other.compressedBytes;
+		for (size_t i = 0; i < 256; ++i) {
+			byteCounts[i] += other.byteCounts[i];
+		}
+		for (size_t b = 0; b < Width; ++b) {
+			ones[b] += other.ones[b];
+		}
+	}
+
+	/* Order-0 entropy in bits per byte */
+	double byteEntropy() const {
+		double bytes = static_cast<double>(values * (Width / 8));
+		double entropy = 0;
+		for (size_t i = 0; i < 256; ++i) {
+			if (byteCounts[i]) {
+				double p = byteCounts[i] / bytes;
+				entropy -= p * std::log2(p);
+			}
+		}
+		return entropy;
+	}
+
+	/* Sum of the entropies of the bit planes in bits per value */
+	double bitPlaneEntropy() const {
+		double entropy = 0;
+		for (size_t b = 0; b < Width; ++b) {
+			if (ones[b] && ones[b] < values) {
+				double p = static_cast<double>(ones[b]) / values;
+				entropy -= p * std::log2(p) + (1 - p) * std::log2(1 - p);
+			}
+		}
+		return entropy;
+	}
+
+	double compressedBitsPerValue() const {
+		return values ? 8.0 * compressedBytes / values : 0;
+	}
+};
+
+/* Adds the byte values of data to counts, four interleaved histograms so equal bytes do not wait on one counter */
+inline void countBytes(const uint8_t* data, size_t n, size_t* counts) {
+
+	uint32_t local[4][256] = {};
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		++local[0][data[i]];
+		++local[1][data[i + 1]];
+		++local[2][data[i + 2]];
+		++local[3][data[i + 3]];
+	}
+	for (; i < n; ++i) {
+		++local[0][data[i]];
+	}
+
+	for (size_t v = 0; v < 256; ++v) {
+		counts[v] += size_t(local[0][v]) + local[1][v] + local[2][v] + local[3][v];
+	}
+}
+
+/*
+* Adds the set bits of every position of values to ones. The AVX2 path takes 32 bytes at a time: a
+* movemask collects one bit of every byte, shifting the bytes left walks through the 8 bits, and the
+* mask of the byte lanes of one position in the values separates the planes for popcount.
+*/
+template<typename Bits>
+inline void countBitPlanes(const Bits* values, size_t n, size_t* ones) {
+
+	constexpr size_t valueBytes = sizeof(Bits);
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	uint32_t laneMasks[valueBytes] = {};
+	for (size_t j = 0; j < 32; ++j) {
+		laneMasks[j % valueBytes] |= uint32_t(1) << j;
+	}
+
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+	size_t total = n * valueBytes;
+	size_t k = 0;
+	for (; k + 32 <= total; k += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + k));
+		for (size_t s = 0; s < 8; ++s) {
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+			for (size_t b = 0; b < valueBytes; ++b) {
+				ones[8 * b + 7 - s] += std::popcount(mask & laneMasks[b]);
+			}
+			v = _mm256_add_epi8(v, v);
+		}
+	}
+	i = k / valueBytes;
+#endif
+
+	for (; i < n; ++i) {
+		for (size_t b = 0; b < valueBytes * 8; ++b) {
+			ones[b] += (values[i] >> b) & 1;
+		}
+	}
+}
+
+/* Bytes of one LZ4 sequence: token, literal length extension, literals, offset and match length extension */
+inline size_t lzSequenceBytes(size_t literals, size_t match) {
+	size_t bytes = 1 + literals;
+	if (literals >= 15) {
+		bytes += (literals - 15) / 255 + 1;
+	}
+	if (match) {
+		bytes += 2;
+		if (match - 4 >= 15) {
+			bytes += (match - 4 - 15) / 255 + 1;
+		}
+	}
+	return bytes;
+}
+
+/*
+* Size of data after LZ4_compress_default (block format of LZ4 1.9, acceleration 1) without writing it:
+* the same hash table and hashes, the search step that grows every 64 misses, the backward extension
+* over pending literals and the retry at the end of every match, so the size is the library's to the byte.
+*/
+inline size_t lzCompressedSize(const uint8_t* data, size_t n) {
+
+	constexpr size_t minMatch = 4;
+	constexpr size_t lastLiterals = 5;
+	constexpr size_t matchMargin = 12;
+	constexpr size_t maxOffset = 65535;
+	constexpr unsigned skipTrigger = 6;
+
+	if (n < matchMargin + 1) {
+		return lzSequenceBytes(n, 0);
+	}
+
+	/* inputs below 64 KiB hash 4 bytes into a table twice as large, longer ones hash 5 bytes */
+	const bool small = n < 65536 + matchMargin - 1;
+	const unsigned hashBits = small ? 13 : 12;
+	std::vector<uint32_t> table(size_t(1) << hashBits, 0);
+
+	auto load32 = [data](size_t at) {
+		uint32_t value;
+		std::memcpy(&value, data + at, 4);
+		return value;
+	};
+	auto load64 = [data](size_t at) {
+		uint64_t value;
+		std::memcpy(&value, data + at, 8);
+		return value;
+	};
+	auto hash = [&](size_t at) -> size_t {
+		if (small) {
+			return (load32(at) * 2654435761u) >> (32 - hashBits);
+		}
+		return ((load64(at) << 24) * 889523592379ull) >> (64 - hashBits);
+	};
+	auto matches = [&](size_t candidate, size_t at) {
+		return candidate + maxOffset >= at && load32(candidate) == load32(at);
+	};
+
+	const size_t matchEnd = n - lastLiterals;
+	const size_t searchEnd = n - matchMargin + 1;
+	size_t size = 0;
+	size_t anchor = 0;
+
+	table[hash(0)] = 0;
+	size_t i = 1;
+	size_t forwardHash = hash(i);
+
+	for (;;) {
+
+		size_t candidate;
+		size_t forward = i;
+		size_t step = 1;
+		size_t misses = size_t(1) << skipTrigger;
+		do {
+			size_t h = forwardHash;
+			i = forward;
+			candidate = table[h];
+			forward += step;
+			step = misses++ >> skipTrigger;
+			if (forward > searchEnd) {
+				return size + lzSequenceBytes(n - anchor, 0);
+			}
+			forwardHash = hash(forward);
+			table[h] = static_cast<uint32_t>(i);
+		} while (!matches(candidate, i));
+
+		while (i > anchor && candidate > 0 && data[i - 1] == data[candidate - 1]) {
+			--i;
+			--candidate;
+		}
+
+		size_t literals = i - anchor;
+		for (;;) {
+
+			size_t length = minMatch;
+			bool mismatch = false;
+			while (!mismatch && i + length + 8 <= matchEnd) {
+				uint64_t difference = load64(candidate + length) ^ load64(i + length);
+				mismatch = difference != 0;
+				length += mismatch ? std::countr_zero(difference) / 8 : 8;
+			}
+			while (!mismatch && i + length < matchEnd && data[candidate + length] == data[i + length]) {
+				++length;
+			}
+
+			size += lzSequenceBytes(literals, length);
+			i += length;
+			anchor = i;
+			if (i >= searchEnd) {
+				return size + lzSequenceBytes(n - anchor, 0);
+			}
+
+			table[hash(i - 2)] = static_cast<uint32_t>(i - 2);
+			size_t h = hash(i);
+			candidate = table[h];
+			table[h] = static_cast<uint32_t>(i);
+			if (!matches(candidate, i)) {
+				break;
+			}
+			literals = 0;
+		}
+
+		forwardHash = hash(++i);
+	}
+}
+
+/*
+* Adds the counts of n values to result. The compressor sees the values split into byte planes, the
+* layout shuffle filters put in front of fast compressors, scratch holds them.
+*/
+template<typename Bits>
+inline void measureCompressibility(const Bits* values, size_t n, compressibility<sizeof(Bits) * 8>& result, std::vector<uint8_t>& scratch) {
+
+	constexpr size_t valueBytes = sizeof(Bits);
+
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+	countBytes(bytes, n * valueBytes, result.byteCounts);
+	countBitPlanes(values, n, result.ones);
+
+	scratch.resize(n * valueBytes);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t b = 0; b < valueBytes; ++b) {
+			scratch[b * n + i] = bytes[i * valueBytes + b];
+		}
+	}
+
+	result.compressedBytes += lzCompressedSize(scratch.data(), scratch.size());
+	result.values += n;
+}
+
+#endif // !ESTIMATOR_H
@@ -0,0 +1,97 @@
+#ifndef FLOATTRAITS_H
+#define FLOATTRAITS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+
+/*
+* Leading bits of the repeating binary expansion of 1/M for every odd M from 3 to maxM, generated at
+* compile time into a flat array indexed by (M - 3) / 2. An odd M > 1 does not divide 2^width, so
+* all ones / M is the truncated expansion floor(2^width / M).
+*/
+template<typename Bits>
+struct reciprocalPatterns {
+
+	static constexpr size_t maxM = 255;
+
+	static constexpr std::array<Bits, (maxM - 1) / 2> generate() {
+		std::array<Bits, (maxM - 1) / 2> table{};
+		for (size_t k = 0; k < table.size(); ++k) {
+			table[k] = static_cast<Bits>(~Bits(0) / (2 * k + 3));
+		}
+		return table;
+	}
+
+	static constexpr std::array<Bits, (maxM - 1) / 2> table = generate();
+
+	static constexpr bool supportsM(size_t M) {
+		return M >= 3 && M <= maxM && M % 2 == 1;
+	}
+
+	static constexpr Bits pattern(size_t M) {
+		return table[(M - 3) / 2];
+	}
+
+	/* The odd M from 3 to largest */
+	static std::vector<size_t> mValues(size_t largest) {
+		std::vector<size_t> values;
+		for (size_t m = 3; m <= largest && m <= maxM; m += 2) {
+			values.push_back(m);
+		}
+		return values;
+	}
+
+};
+
+/*
+* Bit level description of the element type the pipeline runs on.
+* pattern(M) holds the leading bits of the binary expansion of 1/M for every supported M,
+* pValues() every amount of low mantissa bits the multiplication analysis may enforce.
+* The analysis searches all pairs of both and prunes them round by round.
+*/
+template<typename T>
+struct floatTraits;
+
+template<>
+struct floatTraits<float> : reciprocalPatterns<uint32_t> {
+
+	typedef uint32_t bits;
+	static constexpr size_t width = 32;
+	static constexpr size_t defaultP = 12;
+
+	static std::vector<size_t> pValues() {
+		std::vector<size_t> values;
+		for (size_t p = 1; p < width; ++p) {
+			values.push_back(p);
+		}
+		return values;
+	}
+
+};
+
+/* The double mantissa has 29 more bits, so the default P is shifted by 29 to sacrifice the same precision */
+template<>
+struct floatTraits<double> : reciprocalPatterns<uint64_t> {
+
+	typedef uint64_t bits;
+	static constexpr size_t width = 64;
+	static constexpr size_t defaultP = 41;
+
+	static std::vector<size_t> pValues() {
+		std::vector<size_t> values;
+		for (size_t p = 1; p < width; ++p) {
+			values.push_back(p);
+		}
+		return values;
+	}
+
+};
+
+/* Entries of the former hand written tables */
+static_assert(floatTraits<float>::pattern(3) == 0b01010101010101010101010101010101);
+static_assert(floatTraits<float>::pattern(19) == 0b00001101011110010100001101011110);
+static_assert(floatTraits<double>::pattern(23) == 0x0B21642C8590B216);
+
+#endif // !FLOATTRAITS_H
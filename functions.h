@@ -4,15 +4,35 @@
 #ifdef _WIN32
 #define C_WIN_CPP
 #include "c-win.cpp"
+#include "mmpolicy.h"
 void munmap_file(void* addr);
+void release_file_range(void* addr, size_t length);
+void page_faults(size_t* minor, size_t* major);
+intptr_t open_for_read(const char* filename, size_t* length, int direct);
+void close_file(intptr_t handle);
+size_t read_at(intptr_t handle, void* buffer, size_t length, size_t offset);
+void* reserve_buffer(size_t length);
+void free_buffer(void* addr, size_t length);
+int uring_read(intptr_t handle, char* buffer, size_t offset, size_t length, size_t block, unsigned depth);
 #else
 #define C_UNIX_H
 #include "c-unx.c"
 static void munmap_file(void* ptr, size_t length);
+static void release_file_range(void* addr, size_t length);
+static void page_faults(size_t* minor, size_t* major);
 #endif
 
 #include "fast_float.h"
 #include "tabulate.hpp"
+#include "threadpool.h"
+#include "csvscan.h"
+#include "decimal.h"
+#include "trailing.h"
+#include "estimator.h"
+#include "multiply.h"
+#include "storage.h"
+#include "npy.h"
+#include "floattraits.h"
 
 #include <fstream>
 #include <filesystem>
@@ -21,11 +41,19 @@ static void munmap_file(void* ptr, size_t length);
 #include <vector>
 #include <string_view>
 #include <mutex>
-#include <bitset>
 #include <limits>
 #include <cmath>
 #include <iomanip>
 #include <map>
+#include <deque>
+#include <condition_variable>
+#include <atomic>
+#include <sstream>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
 
 using namespace tabulate;
 using namespace fast_float;
@@ -35,15 +63,16 @@ using Row_t = Table::Row_t;
 typedef std::string_view strvw;
 typedef std::pair<size_t, size_t> coords;
 
+template<typename T>
 struct multResult {
 
 	std::vector<size_t> tralingSymbols;
-	float mse;
-	float maxRelativeDeviation;
+	T mse;
+	T maxRelativeDeviation;
 
 
 	multResult() {
-		this->tralingSymbols.resize(33);
+		this->tralingSymbols.resize(floatTraits<T>::width + 1);
 		this->mse = 0;
 		this->maxRelativeDeviation = 0;
 	}
@@ -51,29 +80,15 @@ struct multResult {
 };
 
 
-void* mmap_file(const char* filename, size_t* length);
+void* mmap_file(const char* filename, size_t* length, int policy);
 void testFile();
 
-struct threadPool {
-	size_t threads;
-	std::vector<std::thread> threadList;
-
-	threadPool() {
-		this->threads = std::thread::hardware_concurrency() - 1;
-	}
-	threadPool(size_t threads) : threads(threads) {
-	};
-
-	~threadPool() {
-		
-	}
-
-	void start() {
-		for (size_t i = 0; i < threads; ++i) {
-			threadList.push_back(std::thread());
-		}
-	}
-
+/* Byte range of one parsing task with the exact amount of rows and fields inside it */
+struct chunkIndex {
+	const char* start;
+	const char* end;
+	size_t rows;
+	size_t fields;
 };
 
 struct metric {
@@ -85,36 +100,196 @@ struct metric {
 	std::string unit;
 
 	metric(std::string name, size_t duration, size_t size, std::string unit) : duration(duration), name(name), size(size), unit(unit) {
-		this->throughput = size / this->duration;
+		this->throughput = this->duration ? size / this->duration : size;
 		this->duration /= 1000;
 	}
 
+	/* Plain counter without a duration, e.g. page faults */
+	metric(std::string name, size_t count) : duration(0), name(name), size(count), throughput(0), unit("") {
+	}
+
 };
 
+/*
+* The input file. With the mmap backend map is the file mapping, with the read backends it is
+* an equally sized page aligned buffer that Dataset::loadUntil fills up to loadedUntil.
+*/
 struct mmfile {
 	void* map;
 	char* charMap;
-	size_t length;
+	size_t length = 0;
 	std::string filename;
-	mmfile(const char* filename) : filename(filename) {
-		map = mmap_file(filename, &length);
+	int policy;
+	int backend;
+	intptr_t handle = -1;
+	size_t loadedUntil = 0;
+	mmfile(const char* filename, int policy = MM_POLICY_NONE, int backend = MM_BACKEND_MMAP) : filename(filename), policy(policy), backend(backend) {
+		if (backend == MM_BACKEND_MMAP) {
+			map = mmap_file(filename, &length, policy);
+		}
+		else {
+			handle = open_for_read(filename, &length, policy & MM_POLICY_DIRECT);
+			map = handle == -1 ? nullptr : reserve_buffer(length);
+		}
+#ifndef _WIN32
+		if (map == MAP_FAILED) {
+			map = nullptr;
+		}
+#endif
 		charMap = static_cast<char*>(map);
 	}
+
+	/* False if the file could not be opened or mapped, or is empty */
+	bool isOpen() const {
+		return map != nullptr && length != 0;
+	}
+
+	static int parseBackend(const std::string& name) {
+		if (name == "pread") {
+			return MM_BACKEND_PREAD;
+		}
+		if (name == "uring") {
+			return MM_BACKEND_URING;
+		}
+		return MM_BACKEND_MMAP;
+	}
+
+	std::string backendName() const {
+		switch (backend) {
+		case MM_BACKEND_PREAD:
+			return "pread";
+		case MM_BACKEND_URING:
+			return "uring";
+		default:
+			return "mmap";
+		}
+	}
+
+	/* Comma separated list of sequential, willneed, populate and hugepage */
+	static int parsePolicy(const std::string& hints) {
+		int policy = MM_POLICY_NONE;
+		std::istringstream iss(hints);
+		std::string hint;
+		while (std::getline(iss, hint, ',')) {
+			if (hint == "sequential") {
+				policy |= MM_POLICY_SEQUENTIAL;
+			}
+			else if (hint == "willneed") {
+				policy |= MM_POLICY_WILLNEED;
+			}
+			else if (hint == "populate") {
+				policy |= MM_POLICY_POPULATE;
+			}
+			else if (hint == "hugepage") {
+				policy |= MM_POLICY_HUGEPAGE;
+			}
+			else if (hint == "direct") {
+				policy |= MM_POLICY_DIRECT;
+			}
+		}
+		return policy;
+	}
+
+	std::string policyName() const {
+		std::string name;
+		if (policy & MM_POLICY_SEQUENTIAL) {
+			name += "sequential,";
+		}
+		if (policy & MM_POLICY_WILLNEED) {
+			name += "willneed,";
+		}
+		if (policy & MM_POLICY_POPULATE) {
+			name += "populate,";
+		}
+		if (policy & MM_POLICY_HUGEPAGE) {
+			name += "hugepage,";
+		}
+		if (policy & MM_POLICY_DIRECT) {
+			name += "direct,";
+		}
+		if (name.empty()) {
+			return "none";
+		}
+		name.pop_back();
+		return name;
+	}
+
 #ifdef _WIN32
 	~mmfile() {
-		munmap_file(map);
+		if (map != nullptr && backend == MM_BACKEND_MMAP) {
+			munmap_file(map);
+		}
+		else if (map != nullptr) {
+			free_buffer(map, length);
+		}
+		if (handle != -1) {
+			close_file(handle);
+		}
 	}
 #else
 	~mmfile() {
-		munmap_file(map, length);
+		if (map != nullptr && backend == MM_BACKEND_MMAP) {
+			munmap_file(map, length);
+		}
+		else if (map != nullptr) {
+			free_buffer(map, length);
+		}
+		if (handle != -1) {
+			close_file(handle);
+		}
 	}
 #endif
 };
 
+/* Format of the input file, binary input has no text to parse */
+enum format { csv, float32, float64, npy };
+
+/* Picks the input format from the -F value, auto decides by file extension */
+inline format detectFormat(const std::string& filename, const std::string& requested) {
+
+	std::string name = requested;
+	if (name == "auto") {
+		name = std::filesystem::path(filename).extension().string();
+		if (!name.empty()) {
+			name.erase(0, 1);
+		}
+		if (name == "bin" || name == "raw") {
+			name = "f32";
+		}
+	}
+
+	if (name == "f32") {
+		return float32;
+	}
+	if (name == "f64") {
+		return float64;
+	}
+	if (name == "npy") {
+		return npy;
+	}
+	return csv;
+}
+
+/* Size of one stored value, 0 for text input and unsupported .npy files */
+inline size_t formatElementSize(const std::string& filename, format inputFormat) {
+
+	if (inputFormat == float64) {
+		return 8;
+	}
+	if (inputFormat == npy) {
+		return npyElementSize(filename);
+	}
+	return inputFormat == float32 ? 4 : 0;
+}
+
+template<typename T>
 class Dataset {
 
 public:
 
+	typedef typename floatTraits<T>::bits bits;
+	static constexpr size_t width = floatTraits<T>::width;
+
 	mmfile file;
 	std::string filename;
 	threadPool* trPool;
@@ -126,27 +301,57 @@ public:
 	std::string exportFilename = "free.lunch";
 	std::vector<metric> metrics;
 
-	//Fast guessing params
+	//Chunking params
 	size_t bytesToCheck = 4096*4;
-	size_t datasetSizeGuess;
-	float guessScaling = 1;
+	size_t chunkBytes = 4096*1024;
+	std::vector<chunkIndex> chunks;
+
+	//Read backends fill the buffer in blocks of ioBlock bytes with up to ioDepth reads in flight
+	size_t ioBlock = 1024 * 1024;
+	unsigned ioDepth = 32;
+
+	//Bytes parsed and busy time of the parsers per core type
+	size_t castBytes[coreKinds] = {};
+	size_t castMicros[coreKinds] = {};
+
+	//Readahead, every parser publishes its position and a helper thread touches the pages ahead of it
+	size_t readaheadDistance = 0;
+	std::vector<std::atomic<const char*>> parserPositions;
 
 
 	//Actual dimensions of dataset
 	size_t amountOfColumns;
 	size_t actualSize = 0;
 	
-	//Parsing params
+	//Streaming params
+	bool streaming = false;
+	size_t rssBudget = 1024 * 1024 * 1024;
+	size_t streamQueueDepth = 2;
+	size_t sampleBytes = 0;
+	std::string outputFilename = "preprocessed_output.csv";
+	std::string outputBuffer;
+
+	//Parsing params, parseHeaders sniffs them from the beginning of the file
 	char lineBreak = '\n';
+	bool crlf = false;
 	char delimiter = ',';
+	bool hasHeader = true;
+	bool quoted = false;
 	
 	std::vector<size_t> timers;
 
 	//Containers for the data
-	std::vector<std::vector<float>> floatResults;
-	float maxInDataset = 0;
-	float minInDataset = 0;
+	columnStore<T> floatColumns;
+	T maxInDataset = 0;
+	T minInDataset = 0;
+	std::vector<T> columnMax;
+	std::vector<T> columnMin;
 	std::vector<std::string> Headers;
+	bool rangeKnown = false;
+
+	//Input format, binary input has no text to parse
+	format inputFormat = csv;
+	size_t binaryColumns = 1;
 
 	//weird variable for thread sync safety
 	std::mutex mtx;
@@ -154,11 +359,30 @@ public:
 	/*
 	* Decision params
 	*/
-	size_t finalM;
-	size_t finalP;
-	float finalPoFive;
+	size_t finalM = 3;
+	size_t finalP = floatTraits<T>::defaultP;
+	T finalPoFive = 25;
 	size_t trailingSymbolsThreshold = 12;
 
+	enum scheme { none, addition, multiplication, powersOfFive };
+	scheme selectedScheme = none;
+
+	/* Scheme and parameters applied to one column */
+	struct columnPlan {
+		scheme selected = none;
+		size_t M = 3;
+		size_t P = floatTraits<T>::defaultP;
+		T bias = 0;
+		T poFive = 25;
+		double meanTrailing = 0;
+		double relativeError = 0;
+		compressibility<width> estimate;
+	};
+	std::vector<columnPlan> columnPlans;
+
+	/* Best candidate of every scheme per column, estimateColumnPlans measures them on the sample */
+	std::vector<std::vector<columnPlan>> columnCandidates;
+
 
 	/*
 	* Analysis params 
@@ -166,8 +390,8 @@ public:
 	size_t defaultTestSizePercent = 5;
 	size_t howManyToTest = 0;
 	//Addition
-	float error = 0;
-	float bias = 0;
+	T error = 0;
+	T bias = 0;
 	
 	//Po5
 	std::vector<size_t> Trailing5;
@@ -177,31 +401,53 @@ public:
 	
 
 	//mult
-	std::vector<size_t> MValues = { 3,5,7,9,11};
-	std::vector<size_t> PValue = {10,12,14,15,16,17,18,20};
-
-	std::map<uint32_t, uint32_t> floatPatternMap = {
-		{3,  0b01010101010101010101010101010101},
-		{5,  0b11001100110011001100110011001100},
-		{7,  0b00100100100100100100100100100100},
-		{9,  0b00011100011100011100011100011100},
-		{11, 0b00010111010001011101000101110100},
-		{13, 0b00010011101100010011101100010011},
-		{15, 0b00010001000100010001000100010001},
-		{17, 0b00001111000011110000111100001111}, // this pattern produces mostly trailing 1s
-		{19, 0b00001101011110010100001101011110}, // this pattern produces mostly trailing 1s
-		{21, 0b00001100001100001100001100001100},
-		{23, 0b00001011001000010110010000101100},
-		{25, 0b00001010001111010111000010100011}, // this pattern produces mostly trailing 1s
-		{27, 0b00001001011110110100001001011110}, // this pattern produces mostly trailing 1s
-		{29, 0b00001000110100111101110010110000},
-		{31, 0b00001000010000100001000010000100}
+	/* The analysis starts from every odd M up to maxMultiplier and every P, pruneCandidates narrows the grid per column */
+	size_t maxMultiplier = 31;
+	std::vector<size_t> PValue = floatTraits<T>::pValues();
+
+	/* Candidates still searched in every column, summed over the columns */
+	std::map<coords, multResult<T>> multResults;
+
+	/* Pruning margins: standard errors of the mean trailing run, factor on errorBudget */
+	static constexpr double pruneDeviations = 3;
+	static constexpr double pruneErrorMargin = 2;
+	size_t multiplicationValues = 0;
+
+	/* Analysis results of one column, the dataset wide results above are their sums */
+	struct columnAnalysis {
+		T error = 0;
+		T bias = 0;
+		std::vector<size_t> trailingRaw;
+		std::vector<size_t> trailingAddition;
+		std::map<coords, multResult<T>> multResults;
+		std::vector<size_t> trailing5;
+		std::vector<size_t> trailing25;
+		std::vector<size_t> trailing125;
+		T powerErrors[3] = { 0, 0, 0 };
 	};
+	std::vector<columnAnalysis> columnResults;
+
+	bool analyzeWhileParsing = false;
+	bool sampleAnalyzed = false;
+
+	/* Sample drawn by planSample, the analysis stops once consecutive rounds differ by at most sampleTolerance */
+	size_t sampleSeed = 0;
+	double sampleTolerance = 0.01;
 
-	std::map<coords, multResult> multResults;
+	/* Largest RMS error relative to the range of a column a scheme may introduce */
+	double errorBudget = 1e-4;
+	std::vector<std::vector<size_t>> sampleBlocks;
+	size_t sampleRounds = 0;
+	size_t analysisRounds = 0;
+
+	/* Rows of a column the fused analysis evaluates at once, and its time per scheme summed over workers */
+	static constexpr size_t analysisBlock = 256;
+	size_t additionMicros = 0;
+	size_t multiplicationMicros = 0;
+	size_t powersOfFiveMicros = 0;
 
 	
-	Dataset(const std::string& filename, threadPool* threads) : file(filename.c_str()), filename(filename), trPool(threads) {
+	Dataset(const std::string& filename, threadPool* threads, int policy = MM_POLICY_NONE, int backend = MM_BACKEND_MMAP) : file(filename.c_str(), policy, backend), filename(filename), trPool(threads) {
 		
 	}
 
@@ -213,7 +459,7 @@ public:
 			Table logTable;
 			logTable.add_row({ "Name", "Duration", "Size" , "Throughput"});
 			logTable.format().column_separator("");
-			logTable.column(0).format().width(30);
+			logTable.column(0).format().width(45);
 			logTable.column(1).format().width(20);
 			logTable.column(2).format().width(20);
 			logTable.column(3).format().width(30);
@@ -227,30 +473,30 @@ public:
 			std::cout << "Amount of floats: " << this->actualSize << " | Columns: " << this->amountOfColumns << "Amount of rows: "<< this->actualSize/this->amountOfColumns << std::endl;
 		}
 
-		if (printAnalysisResults) {
+		if (printAnalysisResults && this->Trailing5.size() == width + 1) {
 
 			Table po5Table;
 			Row_t header{ "Power/Trailing" };
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				header.push_back(std::to_string(i));
 			}
 			po5Table.add_row(header);
 			po5Table.format().column_separator("");
 			
 			Row_t row5{"1"};
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				row5.push_back(std::to_string(this->Trailing5[i]));
 			}
 			po5Table.add_row(row5);
 
 			Row_t row25{"2"};
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				row25.push_back(std::to_string(this->Trailing25[i]));
 			}
 			po5Table.add_row(row25);
 
 			Row_t row125{ "3" };
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				row125.push_back(std::to_string(this->Trailing125[i]));
 			}
 			po5Table.add_row(row125);
@@ -274,7 +520,7 @@ public:
 			
 			Table multTable;
 			Row_t headerMult{ "M","P","MSE","Max % Dev" };
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				headerMult.push_back(std::to_string(i));
 			}
 			//multTable.add_row(headerMult);
@@ -293,7 +539,7 @@ public:
 				}
 
 				Row_t rowMult{ std::to_string(res.first.first), std::to_string(res.first.second), mseString, std::to_string(100*res.second.maxRelativeDeviation) };
-				for(int i = 1; i < 33; ++i){
+				for(size_t i = 1; i <= width; ++i){
 					rowMult.push_back(std::to_string(res.second.tralingSymbols[i]));
 				}
 				multTable.add_row(rowMult);
@@ -302,6 +548,22 @@ public:
 
 		}
 
+		if (printAnalysisResults && !this->columnPlans.empty()) {
+
+			Table planTable;
+			planTable.format().column_separator("");
+			planTable.add_row({ "Column", "Scheme", "Parameters", "Mean trailing", "Relative error", "Byte entropy", "Bit plane entropy", "Compressed bits" });
+			for (size_t c = 0; c < this->columnPlans.size(); ++c) {
+				const columnPlan& plan = this->columnPlans[c];
+				std::stringstream errorStream;
+				errorStream << std::scientific << plan.relativeError;
+				planTable.add_row({ c < this->Headers.size() ? this->Headers[c] : std::to_string(c), schemeName(plan.selected), planParameters(plan), std::to_string(plan.meanTrailing), errorStream.str(),
+					std::to_string(plan.estimate.byteEntropy()), std::to_string(plan.estimate.bitPlaneEntropy()), std::to_string(plan.estimate.compressedBitsPerValue()) });
+			}
+			std::cout << planTable << std::endl;
+
+		}
+
 		if (exportResults) {
 
 			exportResultsToFile();
@@ -310,472 +572,1352 @@ public:
 		
 	}
 	
-	void calculateBiasForAddition() {
-
-		size_t difference = this->maxInDataset - this->minInDataset;
-		size_t log2 = std::log2(difference);
-		this->bias = std::pow(2, log2+1) - this->minInDataset;
+	static std::string schemeName(scheme selected) {
+		switch (selected) {
+		case addition:
+			return "addition";
+		case multiplication:
+			return "multiplication";
+		case powersOfFive:
+			return "powers of five";
+		default:
+			return "none";
+		}
+	}
 
+	/* The parameters of the scheme of a plan, M,P / bias / power */
+	static std::string planParameters(const columnPlan& plan) {
+		std::stringstream ss;
+		switch (plan.selected) {
+		case addition:
+			ss << plan.bias;
+			break;
+		case multiplication:
+			ss << plan.M << "," << plan.P;
+			break;
+		case powersOfFive:
+			ss << plan.poFive;
+			break;
+		default:
+			break;
+		}
+		return ss.str();
 	}
 
-	void runAddition() {
+	void calculateBiasForAddition() {
 
-		size_t howManyPerThread = (this->actualSize / (100 / this->defaultTestSizePercent)) / this->trPool->threads;
-		this->howManyToTest = howManyPerThread * this->trPool->threads;
+		ensureRange();
 
-		float meanFactor = 1.0f / (howManyPerThread * this->trPool->threads);
+		this->bias = biasForRange(this->maxInDataset, this->minInDataset);
+		for (size_t c = 0; c < this->columnResults.size() && c < this->columnMax.size(); ++c) {
+			this->columnResults[c].bias = biasForRange(this->columnMax[c], this->columnMin[c]);
+		}
 
-		calculateBiasForAddition();
+	}
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i] = std::thread(&Dataset::analyzeAddition, this, i, howManyPerThread, this->bias, meanFactor);
-		};
+	/* Shifts [min, max] above the next power of two of its width, 0 for a column without values */
+	static T biasForRange(T max, T min) {
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
+		if (max < min) {
+			return 0;
 		}
 
+		size_t difference = max - min;
+		size_t log2 = difference ? std::log2(difference) : 0;
+		return std::pow(2, log2+1) - min;
 	}
 
-	void analyzeAddition(size_t threadIdx, size_t length, float bias, float meanFactor) {
+	/* Addition analysis alone, on the same sample and with the same stop rule as the full analysis */
+	void runAddition() {
+		runAnalysis(false);
+	}
+
+	/*
+	* Draws the sample. Every row group is a stratum of analysisBlock row blocks and sampleBlocks[g] lists
+	* them in an order shuffled with sampleSeed, at most defaultTestSizePercent % of the rows of the group.
+	* Round r of the analysis takes the blocks [2^r - 1, 2^(r+1) - 1) of every group, so each round doubles the sample.
+	*/
+	void planSample() {
 
-		std::vector<float> *threadSubset = &this->floatResults[threadIdx];
+		this->sampleBlocks.assign(this->floatColumns.groups.size(), {});
+		this->sampleRounds = 0;
 
-		float mse = 0;
+		for (size_t g = 0; g < this->floatColumns.groups.size(); ++g) {
 
-		for (size_t i = 0; i < length; ++i) {
+			size_t rows = this->floatColumns.groups[g].rows;
+			size_t blocks = (rows + analysisBlock - 1) / analysisBlock;
+			size_t wanted = (rows * this->defaultTestSizePercent / 100 + analysisBlock - 1) / analysisBlock;
+			wanted = std::min(blocks, std::max<size_t>(wanted, 1));
 
-			float value = (*threadSubset)[i] + bias;
-			mse += meanFactor * std::pow(value - bias - (*threadSubset)[i], 2);
+			std::vector<size_t>& order = this->sampleBlocks[g];
+			order.resize(blocks);
+			std::iota(order.begin(), order.end(), size_t(0));
+			std::mt19937_64 random(this->sampleSeed * 0x9E3779B97F4A7C15ull + g);
+			std::shuffle(order.begin(), order.end(), random);
+			order.resize(wanted);
 
-			
+			size_t rounds = 0;
+			while ((size_t(1) << rounds) - 1 < wanted) {
+				++rounds;
+			}
+			this->sampleRounds = std::max(this->sampleRounds, rounds);
 		}
-		std::lock_guard<std::mutex> lock(mtx);
-		this->error += mse;
-		
 	}
 
-	void runMultiplication() {
-		
-		for (auto m : this->MValues) {
-
-			for (auto p : this->PValue) {
+	/* Positions in sampleBlocks[groupIdx] analysed in round */
+	std::pair<size_t, size_t> roundBlocks(size_t groupIdx, size_t round) {
+		size_t planned = this->sampleBlocks[groupIdx].size();
+		size_t first = std::min(planned, (size_t(1) << round) - 1);
+		size_t last = std::min(planned, (size_t(1) << (round + 1)) - 1);
+		return { first, last };
+	}
 
-				multResults[coords(m, p)] = multResult();
+	/*
+	* Rows [first, last) of the block at position k of sampleBlocks[groupIdx]. The sample is planned on the
+	* indexed row counts, a group that parsed fewer rows yields an empty or shorter block.
+	*/
+	std::pair<size_t, size_t> blockRows(size_t groupIdx, size_t k) {
+		size_t rows = this->floatColumns.groups[groupIdx].rows;
+		size_t first = std::min(rows, this->sampleBlocks[groupIdx][k] * analysisBlock);
+		return { first, std::min(rows, first + analysisBlock) };
+	}
 
+	/* Amount of values over all columns in the blocks of the first rounds */
+	size_t sampledValues(size_t rounds) {
+		size_t total = 0;
+		for (size_t g = 0; g < this->sampleBlocks.size(); ++g) {
+			size_t planned = std::min(this->sampleBlocks[g].size(), (size_t(1) << rounds) - 1);
+			for (size_t k = 0; k < planned; ++k) {
+				auto [first, last] = blockRows(g, k);
+				total += last - first;
 			}
-
-		}
-		
-		size_t howManyPerThread = (this->actualSize / (100 / this->defaultTestSizePercent)) / this->trPool->threads;
-		this->howManyToTest = howManyPerThread * this->trPool->threads;
-		float meanFactor = 1.0f / (howManyPerThread*this->trPool->threads);
-
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i] = std::thread(&Dataset::analyzeMultiplication, this, i, howManyPerThread, this->MValues, this->PValue, this->floatPatternMap, meanFactor);
-		};
-
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
 		}
+		return total * this->amountOfColumns;
 	}
 
-	void analyzeMultiplication(size_t threadIdx, size_t length, std::vector<size_t> MVals, std::vector<size_t> PVals, std::map<uint32_t, uint32_t> patterns, float meanFactor) {
-
-		std::vector<float> *threadSubset = &this->floatResults[threadIdx];
-
-		for (auto m : MVals) {
+	void accumulateAddition(const columnSpan<T>& column, size_t first, size_t last, T bias, T& squaredError, trailingHistogram<trailingRuns, bits>& histogram) {
 
-			for (auto p : PVals) {
+		for (size_t i = first; i < last; ++i) {
 
-				multResult localThreadResult;
-
-				uint32_t patternPrep = 0xFFFFFFFF << p;
-
-				uint32_t patternToEnforce = patterns[m] >> (32 - p);
+			if (std::isnan(column[i])) {
+				continue;
+			}
 
-				for (size_t i = 0; i < length; ++i) {
+			T value = column[i] + bias;
+			histogram.push(std::bit_cast<bits>(value));
+			squaredError += std::pow(value - bias - column[i], 2);
 
-					if((*threadSubset)[i] != 0) {
+		}
+	}
 
-						float value = (*threadSubset)[i];
+	/*
+	* Runs the analysis round by round until the estimates are stable within sampleTolerance or the
+	* sample is exhausted. The error sums are divided by the amount of sampled values at the end.
+	* If the parser already analysed the first round, only its addition is left since the bias needs
+	* the range of the whole dataset.
+	*/
+	void runAnalysis(bool multiplicative = true) {
 
-						uint32_t* ptrUint = reinterpret_cast<uint32_t*>(&value);
+		if (!this->sampleAnalyzed) {
+			prepareAnalysis();
+		}
 
-						*ptrUint = (*ptrUint & patternPrep) | patternToEnforce;
+		calculateBiasForAddition();
 
-						value *= m;
+		sampleEstimate previous;
+		size_t round = 0;
+		while (round < this->sampleRounds) {
 
-						this->countTrailingSymbols(&value, &localThreadResult.tralingSymbols);
-						
-						float deviation = value / m - (*threadSubset)[i];
-						localThreadResult.mse += meanFactor * std::pow(deviation, 2);
+			bool parsed = this->sampleAnalyzed && round == 0;
+			trPool->parallelFor(floatColumns.groups.size(), [this, round, multiplicative, parsed](size_t groupIdx, size_t) {
+				analyzeSample(groupIdx, round, true, multiplicative && !parsed);
+			});
+			++round;
 
-						deviation = std::abs(deviation / (*threadSubset)[i]);
+			if (multiplicative) {
+				for (size_t c = 0; c < this->columnResults.size(); ++c) {
+					T range = c < this->columnMax.size() ? this->columnMax[c] - this->columnMin[c] : 0;
+					pruneCandidates(this->columnResults[c], range);
+				}
+				gatherMultiplication();
+			}
 
-						if (localThreadResult.maxRelativeDeviation < deviation) {
-							localThreadResult.maxRelativeDeviation = deviation;
-						}
+			sampleEstimate current = estimateSample(sampledValues(round), multiplicative);
+			if (round > 1 && current.stableAgainst(previous, this->sampleTolerance)) {
+				break;
+			}
+			previous = std::move(current);
+		}
 
-					}
-					else {
-						++localThreadResult.tralingSymbols[32];
-					}
-				}
+		this->analysisRounds = round;
+		this->howManyToTest = sampledValues(round);
 
-				std::lock_guard<std::mutex> lock(mtx);
-				std::vector<size_t> & globalTrailingSymbols = multResults[coords(m, p)].tralingSymbols;
-				for (int i = 0; i < 33; ++i) {
-					globalTrailingSymbols[i] += localThreadResult.tralingSymbols[i];
+		if (this->howManyToTest) {
+			T values = static_cast<T>(this->howManyToTest);
+			this->error /= values;
+			for (auto& result : multResults) {
+				result.second.mse /= values;
+			}
+			/* every column holds the same amount of sampled values */
+			T columnValues = values / this->amountOfColumns;
+			for (auto& column : columnResults) {
+				column.error /= columnValues;
+				for (T& powerError : column.powerErrors) {
+					powerError /= columnValues;
 				}
-				multResults[coords(m, p)].mse += localThreadResult.mse;
-				if (multResults[coords(m, p)].maxRelativeDeviation < localThreadResult.maxRelativeDeviation) {
-					multResults[coords(m, p)].maxRelativeDeviation = localThreadResult.maxRelativeDeviation;
+				for (auto& result : column.multResults) {
+					result.second.mse /= columnValues;
 				}
 			}
-
 		}
-		
-
 	}
-	void parseHeaders() {
-		char* last = file.charMap;
-		char * start = file.charMap;
-		std::vector<std::string> headers;
-		while (*start != this->lineBreak) {
-
-			if (*start == this->delimiter) {
 
-				std::string header(last, start - last);
-				headers.push_back(header);
-				last = start + 1;
+	/* Resets the analysis results and draws the sample, the row groups have to be partitioned */
+	void prepareAnalysis() {
 
+		multResults.clear();
+		this->multiplicationValues = 0;
+		for (auto m : floatTraits<T>::mValues(this->maxMultiplier)) {
+			for (auto p : this->PValue) {
+				multResults[coords(m, p)] = multResult<T>();
 			}
-
-			++start;
-
 		}
-
-		std::string header(last, start -1 - last);
-		headers.push_back(header);
-		this->file.charMap = start + 1;
-		this->Headers = std::move(headers);
+		Trailing5.assign(width + 1, 0);
+		Trailing25.assign(width + 1, 0);
+		Trailing125.assign(width + 1, 0);
+		this->error = 0;
+
+		columnAnalysis empty;
+		empty.multResults = multResults;
+		empty.trailingRaw.assign(width + 1, 0);
+		empty.trailingAddition.assign(width + 1, 0);
+		empty.trailing5.assign(width + 1, 0);
+		empty.trailing25.assign(width + 1, 0);
+		empty.trailing125.assign(width + 1, 0);
+		this->columnResults.assign(this->amountOfColumns, empty);
+
+		planSample();
 	}
 
-	void guessDatasetSize(){
-		size_t nextPosition = 0;
-		strvw chunk(file.charMap, this->bytesToCheck);
-		size_t lineCount = 0;
+	/* Mean errors and trailing symbol fractions after a round, the stop rule compares consecutive ones */
+	struct sampleEstimate {
+		std::vector<double> errors;
+		std::vector<double> fractions;
+
+		/* Errors may change by tolerance relative to their size, fractions by tolerance */
+		bool stableAgainst(const sampleEstimate& other, double tolerance) const {
+			if (errors.size() != other.errors.size() || fractions.size() != other.fractions.size()) {
+				return false;
+			}
+			for (size_t i = 0; i < errors.size(); ++i) {
+				if (std::abs(errors[i] - other.errors[i]) > tolerance * std::max(std::abs(errors[i]), std::abs(other.errors[i]))) {
+					return false;
+				}
+			}
+			for (size_t i = 0; i < fractions.size(); ++i) {
+				if (std::abs(fractions[i] - other.fractions[i]) > tolerance) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
 
-		while ((nextPosition = chunk.find(this->lineBreak, nextPosition)) != strvw::npos) {
+	sampleEstimate estimateSample(size_t values, bool multiplicative) {
 
-			++nextPosition;
-			++lineCount;
+		sampleEstimate estimate;
+		double n = values ? static_cast<double>(values) : 1.0;
 
+		estimate.errors.push_back(this->error / n);
+		if (!multiplicative) {
+			return estimate;
 		}
 
-		nextPosition = 0;
-		strvw firstLineEnd = chunk.substr(0, chunk.find(this->lineBreak, nextPosition));
-		size_t columns = 1;
-		while ((nextPosition = firstLineEnd.find(this->delimiter, nextPosition)) != strvw::npos) {
-			++nextPosition;
-			++columns;
+		for (auto& result : multResults) {
+			estimate.errors.push_back(result.second.mse / n);
+			for (size_t count : result.second.tralingSymbols) {
+				estimate.fractions.push_back(count / n);
+			}
 		}
-
-		size_t bytesUsedOnDel = (columns - 1) * lineCount;
-		size_t bytesUsedOnFloats = chunk.find_last_of(this->lineBreak) - bytesUsedOnDel - lineCount;
-
-		size_t bytesPerFloat = bytesUsedOnFloats / (columns * lineCount);
-		this->datasetSizeGuess = guessScaling*this->file.length / bytesPerFloat;
-		amountOfColumns = columns;
+		for (const std::vector<size_t>* trailing : { &Trailing5, &Trailing25, &Trailing125 }) {
+			for (size_t count : *trailing) {
+				estimate.fractions.push_back(count / n);
+			}
+		}
+		return estimate;
 	}
 
-	/* Used after parsing headers */
-	void guessDatasetSize(char* afterHeaders) {
-		size_t nextPosition = 0;
-		strvw chunk(afterHeaders, this->bytesToCheck);
-		size_t lineCount = 0;
-
-		while ((nextPosition = chunk.find(this->lineBreak, nextPosition)) != strvw::npos) {
-
-			++nextPosition;
-			++lineCount;
+	/*
+	* Analyses the blocks of round of one group. Every block of a column is evaluated by the addition,
+	* all multiplication candidates and the powers of five while it is in cache.
+	*/
+	void analyzeSample(size_t groupIdx, size_t round, bool addition, bool multiplicative) {
 
+		rowGroup<T>& group = this->floatColumns.groups[groupIdx];
+		std::pair<size_t, size_t> blocks = roundBlocks(groupIdx, round);
+		if (blocks.first == blocks.second) {
+			return;
 		}
 
-		nextPosition = 0;
-		strvw firstLineEnd = chunk.substr(0, chunk.find(this->lineBreak, nextPosition));
-		size_t columns = 1;
-		while ((nextPosition = firstLineEnd.find(this->delimiter, nextPosition)) != strvw::npos) {
-			++nextPosition;
-			++columns;
-		}
+		/* the candidates left in a column and one set of results reused for every column */
+		std::vector<coords> candidates;
+		std::vector<typename multiplicationKernels<T>::analyzeKernel> kernels;
+		std::vector<bits> patternPreps;
+		std::vector<bits> patternsToEnforce;
+		std::vector<multResult<T>> results;
+		T tile[analysisBlock];
+		bits transformed[analysisBlock];
+		uint8_t lengths[analysisBlock];
+		size_t multiplied = 0;
+
+		std::vector<size_t> trailingRaw(width + 1);
+		std::vector<size_t> trailingAddition(width + 1);
+		std::vector<size_t> trailingSymbols5(width + 1);
+		std::vector<size_t> trailingSymbols25(width + 1);
+		std::vector<size_t> trailingSymbols125(width + 1);
+		auto histogramRaw = std::make_unique<trailingHistogram<trailingRuns, bits>>(trailingRaw);
+		auto histogramAddition = std::make_unique<trailingHistogram<trailingRuns, bits>>(trailingAddition);
+		auto histogram5 = std::make_unique<trailingHistogram<trailingRunsPo5, bits>>(trailingSymbols5);
+		auto histogram25 = std::make_unique<trailingHistogram<trailingRunsPo5, bits>>(trailingSymbols25);
+		auto histogram125 = std::make_unique<trailingHistogram<trailingRunsPo5, bits>>(trailingSymbols125);
+
+		std::chrono::nanoseconds additionTime(0), multiplicationTime(0), powersOfFiveTime(0);
+
+		for (size_t c = 0; c < this->amountOfColumns; ++c) {
+
+			const columnSpan<T> column = group.column(c);
+			T columnBias = this->columnResults[c].bias;
+			T squaredError = 0;
+			T powerErrors[3] = { 0, 0, 0 };
+
+			candidates.clear();
+			kernels.clear();
+			patternPreps.clear();
+			patternsToEnforce.clear();
+			if (multiplicative) {
+				/* pruning only runs between rounds, so the candidates of the column do not change under us */
+				for (const auto& candidate : this->columnResults[c].multResults) {
+					candidates.push_back(candidate.first);
+					kernels.push_back(multiplicationKernels<T>::forM(candidate.first.first).analyze);
+					patternPreps.push_back(~bits(0) << candidate.first.second);
+					patternsToEnforce.push_back(floatTraits<T>::pattern(candidate.first.first) >> (width - candidate.first.second));
+				}
+			}
+			if (results.size() < candidates.size()) {
+				results.resize(candidates.size());
+			}
 
-		size_t bytesUsedOnDel = (columns - 1) * lineCount;
-		size_t bytesUsedOnFloats = chunk.find_last_of(this->lineBreak) - bytesUsedOnDel - lineCount;
+			for (size_t k = blocks.first; k < blocks.second; ++k) {
 
-		size_t bytesPerFloat = bytesUsedOnFloats / (columns * lineCount);
-		this->datasetSizeGuess = guessScaling * this->file.length / bytesPerFloat;
-		amountOfColumns = columns;
-	}
+				auto [first, last] = blockRows(groupIdx, k);
 
-	void castFloats(const char* start, const char* end, size_t threadIdx) {
-		std::vector<float> floatResult(this->datasetSizeGuess/this->trPool->threads);
-		
-		float max = std::numeric_limits<float>::min();
-		float min = std::numeric_limits<float>::max();
-		
-		size_t counter = 0;
+				auto begin = std::chrono::steady_clock::now();
+				if (addition) {
+					accumulateAddition(column, first, last, columnBias, squaredError, *histogramAddition);
+				}
 
-		from_chars_result result;
-		result.ptr = start-1;
+				auto added = std::chrono::steady_clock::now();
+				/* the tile of the block stays in L1 while every candidate runs over it */
+				size_t tileSize = 0;
+				for (size_t i = first; i < last && !candidates.empty(); ++i) {
+					if (!std::isnan(column[i])) {
+						tile[tileSize++] = column[i];
+					}
+				}
+				for (size_t j = 0; j < candidates.size(); ++j) {
+					accumulateMultiplication(tile, tileSize, kernels[j], candidates[j].first, patternPreps[j], patternsToEnforce[j], results[j], transformed, lengths);
+				}
+				multiplied += candidates.size() * (last - first);
 
-		while (++result.ptr < end){
+				auto multipliedAt = std::chrono::steady_clock::now();
+				if (multiplicative) {
+					accumulatePowersOfFive(column, first, last, *histogramRaw, *histogram5, *histogram25, *histogram125, powerErrors);
+				}
 
-			result = from_chars(result.ptr, start + (start - end), floatResult[counter]);
-			if(result.ec == std::errc::invalid_argument){
-				
+				auto end = std::chrono::steady_clock::now();
+				additionTime += added - begin;
+				multiplicationTime += multipliedAt - added;
+				powersOfFiveTime += end - multipliedAt;
 			}
-			else {
 
-				if (floatResult[counter] > max) {
-					max = floatResult[counter];
+			histogramRaw->flush();
+			histogramAddition->flush();
+			histogram5->flush();
+			histogram25->flush();
+			histogram125->flush();
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				columnAnalysis& columnResult = this->columnResults[c];
+				this->error += squaredError;
+				columnResult.error += squaredError;
+				for (size_t j = 0; j < candidates.size(); ++j) {
+					mergeMultiplication(columnResult.multResults[candidates[j]], results[j]);
 				}
-				if (floatResult[counter] < min) {
-					min = floatResult[counter];
+				for (int p = 0; p < 3; ++p) {
+					columnResult.powerErrors[p] += powerErrors[p];
+				}
+				for (size_t i = 0; i <= width; ++i) {
+					columnResult.trailingRaw[i] += trailingRaw[i];
+					columnResult.trailingAddition[i] += trailingAddition[i];
+					Trailing5[i] += trailingSymbols5[i];
+					Trailing25[i] += trailingSymbols25[i];
+					Trailing125[i] += trailingSymbols125[i];
+					columnResult.trailing5[i] += trailingSymbols5[i];
+					columnResult.trailing25[i] += trailingSymbols25[i];
+					columnResult.trailing125[i] += trailingSymbols125[i];
 				}
-
-				++counter;
 			}
-		}
-		
-		floatResult.resize(counter);
-		this->floatResults[threadIdx] = std::move(floatResult);
-		std::lock_guard<std::mutex> lock(mtx);
-		actualSize += counter;
 
-		if (max > maxInDataset) {
-			maxInDataset = max;
-		}
-		if (min < minInDataset) {
-			minInDataset = min;
+			for (auto& result : results) {
+				std::fill(result.tralingSymbols.begin(), result.tralingSymbols.end(), 0);
+				result.mse = 0;
+				result.maxRelativeDeviation = 0;
+			}
+			for (auto* trailing : { &trailingRaw, &trailingAddition, &trailingSymbols5, &trailingSymbols25, &trailingSymbols125 }) {
+				std::fill(trailing->begin(), trailing->end(), 0);
+			}
 		}
 
+		std::lock_guard<std::mutex> lock(mtx);
+		this->multiplicationValues += multiplied;
+		this->additionMicros += std::chrono::duration_cast<std::chrono::microseconds>(additionTime).count();
+		this->multiplicationMicros += std::chrono::duration_cast<std::chrono::microseconds>(multiplicationTime).count();
+		this->powersOfFiveMicros += std::chrono::duration_cast<std::chrono::microseconds>(powersOfFiveTime).count();
 	}
 
-	void startCastingProcess() {
-
-		size_t chunkSize = file.length / trPool->threads;
-		
-		const char* start = file.charMap;
+	/* Evaluates a tile of values without NaN for one (M,P) candidate, the trailing runs of the products are counted through lengths */
+	void accumulateMultiplication(const T* tile, size_t n, typename multiplicationKernels<T>::analyzeKernel kernel, size_t m, bits patternPrep, bits patternToEnforce, multResult<T>& result, bits* transformed, uint8_t* lengths) {
 
+		double squaredError = 0;
+		kernel(tile, n, m, patternPrep, patternToEnforce, transformed, squaredError, result.maxRelativeDeviation);
+		result.mse += static_cast<T>(squaredError);
 
-		std::vector<const char*> startingPoints(trPool->threads);
-		std::vector<const char*> endingPoints(trPool->threads);
-		
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			
-			strvw chunk(start, chunkSize);
-			size_t position = chunk.find_last_of(this->lineBreak);
-			startingPoints[i] = start;
-			endingPoints[i] = start + position;
-			start += ++position;
+		trailingLengths<trailingRuns>(transformed, n, lengths);
+		for (size_t k = 0; k < n; ++k) {
+			++result.tralingSymbols[lengths[k]];
 		}
+	}
 
-		endingPoints[trPool->threads -1] = file.charMap + file.length;
-
-		this->floatResults.resize(trPool->threads);
+	/* Mean and standard error of the mean of a trailing histogram */
+	static std::pair<double, double> trailingMoments(const std::vector<size_t>& histogram) {
+		double values = 0;
+		double sum = 0;
+		double squares = 0;
+		for (size_t i = 0; i < histogram.size(); ++i) {
+			values += histogram[i];
+			sum += static_cast<double>(i) * histogram[i];
+			squares += static_cast<double>(i) * i * histogram[i];
+		}
+		if (values == 0) {
+			return { 0, 0 };
+		}
+		double mean = sum / values;
+		double variance = std::max(0.0, squares / values - mean * mean);
+		return { mean, std::sqrt(variance / values) };
+	}
 
-		for (int i = 0; i < trPool->threads; ++i) {
-			
-			trPool->threadList[i] = std::thread(&Dataset::castFloats, this, startingPoints[i], endingPoints[i], i);
+	/*
+	* Branch and bound over the (M,P) grid of one column after a round. A candidate is dropped once its
+	* relative error exceeds errorBudget by pruneErrorMargin or its mean trailing run, pruneDeviations
+	* standard errors up, stays below the best candidate within the budget the same amount down. The
+	* selection keeps the longest run within the budget, so dropped candidates could not have won.
+	*/
+	void pruneCandidates(columnAnalysis& result, T range) {
 
+		double bestLower = -1;
+		for (const auto& candidate : result.multResults) {
+			size_t values = std::accumulate(candidate.second.tralingSymbols.begin(), candidate.second.tralingSymbols.end(), size_t(0));
+			if (values == 0 || relativeError(candidate.second.mse / values, range) > this->errorBudget) {
+				continue;
+			}
+			std::pair<double, double> moments = trailingMoments(candidate.second.tralingSymbols);
+			bestLower = std::max(bestLower, moments.first - pruneDeviations * moments.second);
 		}
 
-		for (int i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
+		for (auto it = result.multResults.begin(); it != result.multResults.end();) {
+			size_t values = std::accumulate(it->second.tralingSymbols.begin(), it->second.tralingSymbols.end(), size_t(0));
+			if (values == 0) {
+				++it;
+				continue;
+			}
+			std::pair<double, double> moments = trailingMoments(it->second.tralingSymbols);
+			bool overBudget = relativeError(it->second.mse / values, range) > pruneErrorMargin * this->errorBudget;
+			bool outscored = moments.first + pruneDeviations * moments.second < bestLower;
+			it = overBudget || outscored ? result.multResults.erase(it) : std::next(it);
 		}
-
 	}
 
-	void runPowersOfFive() {
+	/* Sums the candidates left in every column into multResults */
+	void gatherMultiplication() {
 
-		Trailing5.resize(33);
-		Trailing25.resize(33);
-		Trailing125.resize(33);
+		multResults.clear();
+		if (this->columnResults.empty()) {
+			return;
+		}
 
-		size_t howmany = (this->actualSize / (100/defaultTestSizePercent))/trPool->threads;
-		this->howManyToTest = howmany * trPool->threads;
+		for (const auto& candidate : this->columnResults[0].multResults) {
+			bool everywhere = true;
+			for (const auto& column : this->columnResults) {
+				everywhere = everywhere && column.multResults.count(candidate.first);
+			}
+			if (!everywhere) {
+				continue;
+			}
+			multResult<T>& total = multResults[candidate.first];
+			for (const auto& column : this->columnResults) {
+				mergeMultiplication(total, column.multResults.at(candidate.first));
+			}
+		}
+	}
 
-		for (int i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i] = std::thread(&Dataset::analyzePowersOfFive, this, howmany, i);
+	/* Adds the result of one worker to global, the caller holds mtx */
+	void mergeMultiplication(multResult<T>& global, const multResult<T>& local) {
+		for (size_t i = 0; i <= width; ++i) {
+			global.tralingSymbols[i] += local.tralingSymbols[i];
 		}
-		
-		for (int i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
+		global.mse += local.mse;
+		if (global.maxRelativeDeviation < local.maxRelativeDeviation) {
+			global.maxRelativeDeviation = local.maxRelativeDeviation;
 		}
-		
 	}
+	/*
+	* Sniffs delimiter, line ending and header presence from the first bytesToCheck bytes and reads the header.
+	* Without a header the columns are numbered and the first row stays part of the data.
+	*/
+	void parseHeaders() {
+		const char* end = file.charMap + std::min(this->bytesToCheck, file.length);
+		loadUntil(end);
 
-	void analyzePowersOfFive(size_t howMany, int threadId) {
-		
-		std::vector<size_t> trailingSymbols5(33);
-		std::vector<size_t> trailingSymbols25(33);
-		std::vector<size_t> trailingSymbols125(33);
-
-		std::vector<float> * fvec = &this->floatResults[threadId];
-		
-		for (int i=0; i < howMany; ++i){
-			
-			float value = 5*(*fvec)[i];	
-			countTrailingSymbolsForPo5(&value, &trailingSymbols5);
+		csvDialect dialect = sniffDialect(file.charMap, end);
+		this->delimiter = dialect.delimiter;
+		this->lineBreak = dialect.lineBreak;
+		this->crlf = dialect.crlf;
+		this->hasHeader = dialect.header;
+		this->quoted = dialect.quoted;
 
-			value = 25.0f * (*fvec)[i];
-			countTrailingSymbolsForPo5(&value, &trailingSymbols25);
+		char* last = file.charMap;
+		char * start = file.charMap;
+		bool inside = false;
+		std::vector<std::string> headers;
+		while (start < end && (inside || *start != this->lineBreak)) {
 
-			value = 125.0f * (*fvec)[i];
-			countTrailingSymbolsForPo5(&value, &trailingSymbols125);
+			if (*start == '"') {
+				inside = !inside;
+			}
+			else if (!inside && *start == this->delimiter) {
 
-		}
-		
-		std::lock_guard<std::mutex> lock(mtx);
-		for (int i = 0; i < 33; ++i) {
-			Trailing5[i] += trailingSymbols5[i];
-			Trailing25[i] += trailingSymbols25[i];
-			Trailing125[i] += trailingSymbols125[i];
-		}
-	
-	}
+				headers.push_back(unquote(last, start));
+				last = start + 1;
 
+			}
 
+			++start;
 
-	inline void countZeroes(float* value, std::vector<size_t>* whereToStore) {
-		uint32_t* floatAsInt = reinterpret_cast<uint32_t*>(value);
-		std::bitset<32> bit(*floatAsInt);
-		short zeroes = 0;
-		while (bit[zeroes] == 0 && zeroes < 32) {
-			++zeroes;
 		}
-		(*whereToStore)[zeroes] += 1;
-	}
 
-	inline void countTrailingSymbolsForPo5(float* value, std::vector<size_t>* whereToStore) {
-		uint32_t* floatAsInt = reinterpret_cast<uint32_t*>(value);
-		std::bitset<32> bit(*floatAsInt);
-		if (bit[0] != bit[1]) {
-			bit[0].flip();
-		}
-		short trailingSymbolCounter = 1;
-		bool LastSymbol = bit[0];
+		const char* headerEnd = start > last && start[-1] == '\r' ? start - 1 : start;
+		headers.push_back(unquote(last, headerEnd));
+		this->amountOfColumns = headers.size();
 
-		while (bit[trailingSymbolCounter] == LastSymbol && trailingSymbolCounter < 32) {
-			++trailingSymbolCounter;
+		if (!this->hasHeader) {
+			headers.clear();
+			for (size_t c = 0; c < this->amountOfColumns; ++c) {
+				headers.push_back(std::to_string(c));
+			}
+			start = file.charMap - 1;
 		}
-		
-		(*whereToStore)[trailingSymbolCounter] += 1;
+		this->file.charMap = start + 1;
+		this->Headers = std::move(headers);
 	}
 
-	inline void countTrailingSymbols(float* value, std::vector<size_t>* whereToStore) {
-		uint32_t* floatAsInt = reinterpret_cast<uint32_t*>(value);
-		std::bitset<32> bit(*floatAsInt);
-		short trailingSymbolCounter = 1;
-		bool LastSymbol = bit[0];
-
-		while (bit[trailingSymbolCounter] == LastSymbol && trailingSymbolCounter < 32) {
-			++trailingSymbolCounter;
+	/* Text of a field without its surrounding quotes, "" inside quotes is one quote */
+	static std::string unquote(const char* begin, const char* end) {
+		if (end - begin < 2 || *begin != '"' || end[-1] != '"') {
+			return std::string(begin, end);
 		}
-		
-		(*whereToStore)[trailingSymbolCounter] += 1;
+		std::string text;
+		for (const char* p = begin + 1; p < end - 1; ++p) {
+			text.push_back(*p);
+			if (*p == '"' && p + 1 < end - 1 && p[1] == '"') {
+				++p;
+			}
+		}
+		return text;
 	}
 
-	
-	void masterPerformAddition() {
-
-		for(size_t i = 0; i < trPool->threads; ++i){
-			trPool->threadList[i] = std::thread(&Dataset::slavePerformAddition, this, this->bias, i);
+	/*
+	* Length of the blank line at position including its line break, 0 if the line has fields.
+	* position has to start a line, with crlf a lone \r before the line break or end is blank as well.
+	*/
+	size_t blankLine(const char* position, const char* end) {
+		if (*position == this->lineBreak) {
+			return 1;
 		}
-
-		for(size_t i=0; i < trPool->threads; ++i){
-			trPool->threadList[i].join();
+		if (this->crlf && *position == '\r') {
+			if (position + 1 == end) {
+				return 1;
+			}
+			if (position[1] == this->lineBreak) {
+				return 2;
+			}
 		}
-
+		return 0;
 	}
 
-	void slavePerformAddition(float bias, size_t threadIdx) {
+	/*
+	* Parses the rows of one chunk into its row group. A field that fails to parse is stored as NaN
+	* and missing trailing fields are filled with NaN, so every value stays in its own column.
+	*/
+	void castFloats(const char* start, const char* end, size_t chunkIdx, size_t workerIdx) {
 
-		for (auto&f: this->floatResults[threadIdx]) {
-			f += bias;
-		}
+		this->floatColumns.allocate(chunkIdx, workerIdx);
+		rowGroup<T>& group = this->floatColumns.groups[chunkIdx];
+		const T missing = std::numeric_limits<T>::quiet_NaN();
+		
+		std::vector<T> max(this->amountOfColumns, std::numeric_limits<T>::lowest());
+		std::vector<T> min(this->amountOfColumns, std::numeric_limits<T>::max());
+		
+		size_t row = 0;
+		size_t column = 0;
+		const char* ptr = start;
+
+		while (ptr < end && row < group.rows) {
+
+			if (column == 0) {
+				size_t blank = blankLine(ptr, end);
+				if (blank > 0) {
+					ptr += blank;
+					continue;
+				}
+			}
+
+			bool quotedField = this->quoted && *ptr == '"';
+			if (quotedField) {
+				++ptr;
+			}
+
+			T value = missing;
+			const char* parsed = parseFixedDecimal<T>(ptr, end, this->delimiter, this->lineBreak, value);
+			from_chars_result result{ parsed, std::errc() };
+			if (!parsed) {
+				result = from_chars(ptr, end, value);
+			}
+			if (result.ec != std::errc()) {
+				value = missing;
+			}
+			else if (column < this->amountOfColumns) {
+
+				if (value > max[column]) {
+					max[column] = value;
+				}
+				if (value < min[column]) {
+					min[column] = value;
+				}
+
+			}
+
+			ptr = result.ptr;
+			if (quotedField) {
+				ptr = closingQuote(ptr, end);
+			}
+			while (ptr < end && *ptr != this->delimiter && *ptr != this->lineBreak) {
+				++ptr;
+			}
+
+			if (column < this->amountOfColumns) {
+				group.columns[column][row] = value;
+			}
+			++column;
+
+			if (ptr < end && *ptr == this->delimiter) {
+				++ptr;
+				continue;
+			}
+
+			for (; column < this->amountOfColumns; ++column) {
+				group.columns[column][row] = missing;
+			}
+			column = 0;
+			++row;
+			++ptr;
+
+			if (this->readaheadDistance) {
+				this->parserPositions[workerIdx].store(ptr, std::memory_order_relaxed);
+			}
+		}
+		
+		group.rows = row;
+		std::lock_guard<std::mutex> lock(mtx);
+		actualSize += row * this->amountOfColumns;
+		mergeRange(max, min);
 
 	}
 
-	void masterPerformMultiplication() {
+	/* Position after the quote that closes the field ptr is in, "" is an escaped quote */
+	static const char* closingQuote(const char* ptr, const char* end) {
+		while (ptr < end) {
+			if (*ptr == '"') {
+				if (ptr + 1 < end && ptr[1] == '"') {
+					ptr += 2;
+					continue;
+				}
+				return ptr + 1;
+			}
+			++ptr;
+		}
+		return end;
+	}
+
+	void startCastingProcess() {
+
+		startCastingProcess(file.charMap, static_cast<const char*>(file.map) + file.length, this->analyzeWhileParsing);
+
+	}
+
+	/*
+	* Loads raw little endian float32/float64 or .npy input. Values of the element type are used in place
+	* through a writable private mapping, so the transforms run straight on the mapped pages. Values of the
+	* other width are converted into owned columns.
+	*/
+	bool loadBinary() {
+
+		char* base = static_cast<char*>(file.map);
+		loadUntil(base + file.length);
 
-		size_t M = this->finalM;
+		size_t offset = 0;
+		size_t elementSize = this->inputFormat == float64 ? 8 : 4;
+		size_t columns = this->binaryColumns;
+		bool columnMajor = false;
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i] = std::thread(&Dataset::slavePerformMultiplication, this, i, M, this->finalP, this->floatPatternMap[M]);
+		if (this->inputFormat == npy) {
+			npyHeader header = parseNpyHeader(base, file.length);
+			if (!header.valid) {
+				std::cerr << "Unsupported .npy file, only little endian float32/float64 arrays with one or two dimensions are read" << std::endl;
+				return false;
+			}
+			offset = header.dataOffset;
+			elementSize = header.elementSize;
+			columnMajor = header.fortranOrder;
+			columns = header.shape.size() == 2 ? header.shape[1] : 1;
+		}
+		if (columns == 0 || offset > file.length) {
+			std::cerr << "Binary input without data" << std::endl;
+			return false;
+		}
+
+		size_t rows = (file.length - offset) / (elementSize * columns);
+		this->amountOfColumns = columns;
+		this->actualSize = rows * columns;
+		this->Headers.clear();
+		for (size_t c = 0; c < columns; ++c) {
+			this->Headers.push_back(std::to_string(c));
+		}
+
+		size_t groupRows = this->chunkBytes / (elementSize * columns);
+		size_t perThread = (rows + trPool->threads - 1) / trPool->threads;
+		if (groupRows == 0 || groupRows > perThread) {
+			groupRows = perThread;
+		}
+
+		if (elementSize == sizeof(T)) {
+			this->floatColumns.view(reinterpret_cast<T*>(base + offset), rows, columns, columnMajor, groupRows);
+			return true;
+		}
+
+		const char* values = base + offset;
+		std::vector<size_t> rowCounts;
+		for (size_t first = 0; first < rows; first += groupRows) {
+			rowCounts.push_back(rows - first < groupRows ? rows - first : groupRows);
+		}
+		this->floatColumns.partition(columns, rowCounts, trPool->threads);
+
+		trPool->parallelFor(rowCounts.size(), [&](size_t groupIdx, size_t workerIdx) {
+			this->floatColumns.allocate(groupIdx, workerIdx);
+			rowGroup<T>& group = this->floatColumns.groups[groupIdx];
+			for (size_t c = 0; c < columns; ++c) {
+				columnSpan<T> column = group.column(c);
+				for (size_t i = 0; i < group.rows; ++i) {
+					size_t row = group.firstRow + i;
+					size_t index = columnMajor ? c * rows + row : row * columns + c;
+					column[i] = elementSize == 8 ? static_cast<T>(reinterpret_cast<const double*>(values)[index]) : static_cast<T>(reinterpret_cast<const float*>(values)[index]);
+				}
+			}
+		});
+
+		return true;
+	}
+
+	/* Adds the range of a group to the column ranges and the dataset range, the caller holds mtx */
+	void mergeRange(const std::vector<T>& max, const std::vector<T>& min) {
+
+		if (this->columnMax.size() != this->amountOfColumns) {
+			this->columnMax.assign(this->amountOfColumns, std::numeric_limits<T>::lowest());
+			this->columnMin.assign(this->amountOfColumns, std::numeric_limits<T>::max());
+		}
+
+		for (size_t c = 0; c < this->amountOfColumns; ++c) {
+			if (max[c] > columnMax[c]) {
+				columnMax[c] = max[c];
+			}
+			if (min[c] < columnMin[c]) {
+				columnMin[c] = min[c];
+			}
+			if (max[c] > maxInDataset) {
+				maxInDataset = max[c];
+			}
+			if (min[c] < minInDataset) {
+				minInDataset = min[c];
+			}
 		}
+	}
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
+	/* Binary input skips parsing, so max and min are only computed once a scheme needs them */
+	void ensureRange() {
+
+		if (this->rangeKnown) {
+			return;
 		}
 
+		trPool->parallelFor(this->floatColumns.groups.size(), [this](size_t groupIdx, size_t) {
+
+			const rowGroup<T>& group = this->floatColumns.groups[groupIdx];
+			std::vector<T> max(this->amountOfColumns, std::numeric_limits<T>::lowest());
+			std::vector<T> min(this->amountOfColumns, std::numeric_limits<T>::max());
+
+			for (size_t c = 0; c < this->amountOfColumns; ++c) {
+				const columnSpan<T> column = group.column(c);
+				for (size_t i = 0; i < group.rows; ++i) {
+					T value = column[i];
+					if (value > max[c]) {
+						max[c] = value;
+					}
+					if (value < min[c]) {
+						min[c] = value;
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mtx);
+			mergeRange(max, min);
+		});
+
+		this->rangeKnown = true;
+	}
+
+	/*
+	* Parses [start, end) into floatColumns, start has to be at the beginning of a row.
+	* Each chunk scatters its rows at the prefix sum of the row counts of the chunks before it.
+	* With analyze the task that parsed a group goes on with the multiplication and powers of five
+	* analysis of the first sample round of it, while the group is in cache and others are being parsed.
+	*/
+	void startCastingProcess(const char* start, const char* end, bool analyze = false) {
+
+		trPool->reweigh();
+		loadUntil(end);
+		indexChunks(start, end);
+
+		std::vector<size_t> rowCounts(this->chunks.size());
+		for (size_t i = 0; i < this->chunks.size(); ++i) {
+			rowCounts[i] = this->chunks[i].rows;
+		}
+
+		this->floatColumns.partition(this->amountOfColumns, rowCounts, trPool->threads);
+		this->rangeKnown = true;
+
+		if (analyze) {
+			prepareAnalysis();
+		}
+
+		std::atomic<bool> parsing{ true };
+		std::thread readahead;
+		if (this->readaheadDistance) {
+			this->parserPositions = std::vector<std::atomic<const char*>>(trPool->threads);
+			readahead = std::thread(&Dataset<T>::readaheadLoop, this, std::ref(parsing), end);
+		}
+
+		trPool->parallelFor(this->chunks.size(), [this, analyze](size_t chunkIdx, size_t workerIdx) {
+			const chunkIndex& chunk = this->chunks[chunkIdx];
+			auto begin = std::chrono::steady_clock::now();
+			castFloats(chunk.start, chunk.end, chunkIdx, workerIdx);
+			size_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+
+			int kind = currentCoreKind();
+			trPool->record(workerIdx, kind, chunk.end - chunk.start, micros);
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				this->castBytes[kind] += chunk.end - chunk.start;
+				this->castMicros[kind] += micros;
+			}
+
+			if (analyze) {
+				analyzeSample(chunkIdx, 0, false, true);
+			}
+		});
+
+		this->sampleAnalyzed = analyze;
+		parsing = false;
+		if (readahead.joinable()) {
+			readahead.join();
+		}
+
+	}
+
+	/* Touches one byte per page in front of every parser until parsing is done */
+	void readaheadLoop(std::atomic<bool>& parsing, const char* end) {
+
+		const size_t page = 4096;
+		std::vector<const char*> touched(this->parserPositions.size(), nullptr);
+		volatile char sink = 0;
+
+		while (parsing.load()) {
+
+			bool worked = false;
+
+			for (size_t w = 0; w < this->parserPositions.size(); ++w) {
+
+				const char* position = this->parserPositions[w].load(std::memory_order_relaxed);
+				if (position == nullptr) {
+					continue;
+				}
+
+				const char* from = touched[w] > position && touched[w] <= position + this->readaheadDistance ? touched[w] : position;
+				const char* to = end - position > static_cast<ptrdiff_t>(this->readaheadDistance) ? position + this->readaheadDistance : end;
+
+				for (const char* p = from; p < to; p += page) {
+					sink = sink + *p;
+					worked = true;
+				}
+				if (from < to) {
+					touched[w] = to;
+				}
+			}
+
+			if (!worked) {
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+
+	}
+
+	/*
+	* Makes sure the file up to to is in memory, a no-op for the mmap backend.
+	* The read backends load in order, so everything before loadedUntil is already there.
+	*/
+	void loadUntil(const char* to) {
+
+		if (file.backend == MM_BACKEND_MMAP) {
+			return;
+		}
+
+		char* base = static_cast<char*>(file.map);
+		size_t begin = file.loadedUntil;
+		size_t end = to - base;
+		if (end <= begin) {
+			return;
+		}
+
+		size_t padded = (file.length + 4095) / 4096 * 4096;
+		end = (end + this->ioBlock - 1) / this->ioBlock * this->ioBlock;
+		if (end > padded) {
+			end = padded;
+		}
+
+		if (file.backend != MM_BACKEND_URING || uring_read(file.handle, base + begin, begin, end - begin, this->ioBlock, this->ioDepth) != 0) {
+			trPool->parallelRange(end - begin, this->ioBlock, [&](size_t first, size_t last, size_t) {
+				read_at(file.handle, base + begin + first, last - first, begin + first);
+			});
+		}
+
+		file.loadedUntil = end;
+	}
+
+	/*
+	* Splits [start, end) at line breaks into chunks of about chunkBytes and counts
+	* the rows and fields of every chunk in parallel, so parsing allocates exactly.
+	*/
+	void indexChunks(const char* start, const char* end) {
+
+		/* on hybrid processors a few chunks per worker let the faster cores take over the tail */
+		size_t amount = (end - start) / this->chunkBytes;
+		size_t minimum = currentCoreKind() == unknownCore ? trPool->threads : 4 * trPool->threads;
+		if (amount < minimum) {
+			amount = minimum;
+		}
+		size_t chunkSize = (end - start) / amount + 1;
+
+		this->chunks.clear();
+
+		while (start < end) {
+
+			size_t remaining = end - start;
+			if (remaining <= chunkSize) {
+				this->chunks.push_back({ start, end, 0, 0 });
+				break;
+			}
+
+			strvw chunk(start, remaining);
+			size_t position = chunk.find_last_of(this->lineBreak, chunkSize - 1);
+			if (position == strvw::npos) {
+				position = chunk.find(this->lineBreak, chunkSize);
+			}
+			if (position == strvw::npos) {
+				this->chunks.push_back({ start, end, 0, 0 });
+				break;
+			}
+			this->chunks.push_back({ start, start + position, 0, 0 });
+			start += ++position;
+		}
+
+		if (this->quoted) {
+			joinQuotedChunks();
+		}
+
+		trPool->parallelFor(this->chunks.size(), [this](size_t chunkIdx, size_t) {
+			chunkIndex& chunk = this->chunks[chunkIdx];
+			symbolCount count = this->quoted ? countQuotedSymbols(chunk.start, chunk.end, this->lineBreak, this->delimiter, '"', this->crlf) : countSymbols(chunk.start, chunk.end, this->lineBreak, this->delimiter, this->crlf);
+			/* The last row has no line break inside the chunk, unless it is a blank \r whose \n ends the chunk */
+			bool openRow = chunk.end > chunk.start && *(chunk.end - 1) != this->lineBreak;
+			if (openRow && this->crlf && *(chunk.end - 1) == '\r') {
+				openRow = chunk.end - 1 > chunk.start && *(chunk.end - 2) != this->lineBreak;
+			}
+			chunk.rows = count.lines - count.blankLines + openRow;
+			chunk.fields = count.lines - count.blankLines + count.delimiters + openRow;
+		});
+
+	}
+
+	/*
+	* A chunk split at a line break inside a quoted field starts inside quotes.
+	* The quotes of every chunk are counted in parallel and such chunks are appended to the one before.
+	*/
+	void joinQuotedChunks() {
+
+		std::vector<size_t> quotes(this->chunks.size());
+		trPool->parallelFor(this->chunks.size(), [&](size_t chunkIdx, size_t) {
+			quotes[chunkIdx] = countSymbols(this->chunks[chunkIdx].start, this->chunks[chunkIdx].end, this->lineBreak, '"', false).delimiters;
+		});
+
+		std::vector<chunkIndex> joined;
+		bool inside = false;
+		for (size_t i = 0; i < this->chunks.size(); ++i) {
+			if (inside) {
+				joined.back().end = this->chunks[i].end;
+			}
+			else {
+				joined.push_back(this->chunks[i]);
+			}
+			/* the line break between two chunks is only a row end if it is outside of quotes */
+			inside = inside != (quotes[i] % 2 == 1);
+		}
+		this->chunks = std::move(joined);
+	}
+
+	/* Moves a line break position back until it is outside of quotes, npos if there is no such line break */
+	size_t unquotedBreak(const char* start, size_t position) {
+
+		if (!this->quoted || position == strvw::npos) {
+			return position;
+		}
+
+		size_t quotes = countSymbols(start, start + position, this->lineBreak, '"', false).delimiters;
+		while (quotes % 2 == 1) {
+			size_t previous = strvw(start, position).find_last_of(this->lineBreak);
+			if (previous == strvw::npos) {
+				return strvw::npos;
+			}
+			quotes -= countSymbols(start + previous, start + position, this->lineBreak, '"', false).delimiters;
+			position = previous;
+		}
+		return position;
+	}
+
+	/* Counts the untouched values and the values times 5, 25 and 125, squaredErrors sums the error of undoing each power */
+	void accumulatePowersOfFive(const columnSpan<T>& column, size_t first, size_t last, trailingHistogram<trailingRuns, bits>& raw, trailingHistogram<trailingRunsPo5, bits>& histogram5, trailingHistogram<trailingRunsPo5, bits>& histogram25, trailingHistogram<trailingRunsPo5, bits>& histogram125, T (&squaredErrors)[3]) {
+
+		for (size_t i = first; i < last; ++i) {
+
+			if (std::isnan(column[i])) {
+				continue;
+			}
+
+			T value5 = 5 * column[i];
+			T value25 = 25.0f * column[i];
+			T value125 = 125.0f * column[i];
+
+			raw.push(std::bit_cast<bits>(column[i]));
+			histogram5.push(std::bit_cast<bits>(value5));
+			histogram25.push(std::bit_cast<bits>(value25));
+			histogram125.push(std::bit_cast<bits>(value125));
+
+			squaredErrors[0] += std::pow(value5 / 5 - column[i], 2);
+			squaredErrors[1] += std::pow(value25 / 25 - column[i], 2);
+			squaredErrors[2] += std::pow(value125 / 125 - column[i], 2);
+
+		}
+	}
+
+
+
+	/* Single value counterparts of trailingHistogram, the analysis loops count through the histograms */
+	inline void countZeroes(T* value, std::vector<size_t>* whereToStore) {
+		(*whereToStore)[trailingLength<trailingZeroes>(std::bit_cast<bits>(*value))] += 1;
+	}
+
+	inline void countTrailingSymbolsForPo5(T* value, std::vector<size_t>* whereToStore) {
+		(*whereToStore)[trailingLength<trailingRunsPo5>(std::bit_cast<bits>(*value))] += 1;
+	}
+
+	inline void countTrailingSymbols(T* value, std::vector<size_t>* whereToStore) {
+		(*whereToStore)[trailingLength<trailingRuns>(std::bit_cast<bits>(*value))] += 1;
 	}
 
 	
+	/* Gives every column the forced scheme with the parameters set on the dataset, the bias is the one of the column */
+	void planColumns(scheme forced) {
+
+		this->columnPlans.assign(this->amountOfColumns, columnPlan());
+		for (size_t c = 0; c < this->amountOfColumns; ++c) {
+			columnPlan& plan = this->columnPlans[c];
+			plan.selected = forced;
+			plan.M = this->finalM;
+			plan.P = this->finalP;
+			plan.poFive = this->finalPoFive;
+			plan.bias = c < this->columnResults.size() ? this->columnResults[c].bias : this->bias;
+		}
+	}
 
-	void slavePerformMultiplication(size_t threadIdx, size_t M, size_t P, uint32_t pattern) {
+	/* Mean length of the trailing run of equal bits, the bits a compressor gets almost for free */
+	static double meanTrailing(const std::vector<size_t>& histogram) {
+		double values = 0;
+		double sum = 0;
+		for (size_t i = 0; i < histogram.size(); ++i) {
+			values += histogram[i];
+			sum += static_cast<double>(i) * histogram[i];
+		}
+		return values ? sum / values : 0;
+	}
 
-		float m = static_cast<float>(M);
-		
-		uint32_t patternPrep = 0xFFFFFFFF << P;
+	/* RMS error relative to the range of the values, a constant column tolerates no error */
+	static double relativeError(T mse, T range) {
+		double rms = std::sqrt(static_cast<double>(mse));
+		if (range > 0) {
+			return rms / static_cast<double>(range);
+		}
+		return rms > 0 ? std::numeric_limits<double>::infinity() : 0;
+	}
 
-		uint32_t patternToEnforce = pattern >> (32 - P);
+	/*
+	* The best candidate of every scheme by its expected compressibility, the mean trailing run of the
+	* transformed values, the bits a compressor gets almost for free. Candidates with a relative error
+	* above errorBudget are out. Leaving the values untouched is always the first candidate.
+	*/
+	std::vector<columnPlan> candidatePlans(const columnAnalysis& result, T range) {
 
+		std::vector<columnPlan> candidates(1);
+		candidates[0].bias = result.bias;
+		candidates[0].meanTrailing = meanTrailing(result.trailingRaw);
 
-		for (auto& f : this->floatResults[threadIdx]) {
+		auto consider = [&](scheme candidate, double trailing, T mse) {
+			double error = relativeError(mse, range);
+			if (error > this->errorBudget) {
+				return false;
+			}
+			if (candidates.back().selected != candidate) {
+				candidates.push_back(candidates[0]);
+				candidates.back().selected = candidate;
+				candidates.back().meanTrailing = -1;
+			}
+			columnPlan& best = candidates.back();
+			if (trailing <= best.meanTrailing) {
+				return false;
+			}
+			best.meanTrailing = trailing;
+			best.relativeError = error;
+			return true;
+		};
 
-			if (f != 0) {
+		consider(addition, meanTrailing(result.trailingAddition), result.error);
 
-				uint32_t* ptr = reinterpret_cast<uint32_t*>(&f);
-				*ptr = (*ptr & patternPrep) | patternToEnforce;
-				f *= m;
+		for (const auto& candidate : result.multResults) {
+			if (consider(multiplication, meanTrailing(candidate.second.tralingSymbols), candidate.second.mse)) {
+				candidates.back().M = candidate.first.first;
+				candidates.back().P = candidate.first.second;
 			}
+		}
 
+		const std::pair<T, const std::vector<size_t>*> powers[] = { { 5, &result.trailing5 }, { 25, &result.trailing25 }, { 125, &result.trailing125 } };
+		for (size_t p = 0; p < 3; ++p) {
+			if (consider(powersOfFive, meanTrailing(*powers[p].second), result.powerErrors[p])) {
+				candidates.back().poFive = powers[p].first;
+			}
 		}
 
+		return candidates;
 	}
 
-	void masterPerformPowersOfFive() {
+	/* The candidate with the longest mean trailing run, a scheme has to beat the untouched values */
+	static columnPlan scorePlan(const std::vector<columnPlan>& candidates) {
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i] = std::thread(&Dataset::slavePerformPowersOfFive, this, i, this->finalPoFive);
+		const columnPlan* best = &candidates[0];
+		for (const columnPlan& candidate : candidates) {
+			if (candidate.meanTrailing > best->meanTrailing) {
+				best = &candidate;
+			}
 		}
+		return *best;
+	}
 
-		for (size_t i = 0; i < trPool->threads; ++i) {
-			trPool->threadList[i].join();
+	/*
+	* Picks the scheme and parameters of every column with scorePlan. The winner over the summed
+	* analysis of all columns becomes the dataset wide choice in selectedScheme, finalM, finalP and finalPoFive.
+	*/
+	void selectColumnPlans() {
+
+		this->columnPlans.assign(this->amountOfColumns, columnPlan());
+		this->columnCandidates.assign(this->amountOfColumns, {});
+
+		columnAnalysis total;
+		total.bias = this->bias;
+		total.multResults = this->multResults;
+		total.trailingRaw.assign(width + 1, 0);
+		total.trailingAddition.assign(width + 1, 0);
+		total.trailing5 = this->Trailing5;
+		total.trailing25 = this->Trailing25;
+		total.trailing125 = this->Trailing125;
+
+		for (size_t c = 0; c < this->columnResults.size(); ++c) {
+
+			const columnAnalysis& result = this->columnResults[c];
+			T range = c < this->columnMax.size() ? this->columnMax[c] - this->columnMin[c] : 0;
+			this->columnCandidates[c] = candidatePlans(result, range);
+			this->columnPlans[c] = scorePlan(this->columnCandidates[c]);
+
+			/* every column has the same amount of values, so the dataset error is the mean of the column errors */
+			total.error += result.error / this->columnResults.size();
+			for (size_t p = 0; p < 3; ++p) {
+				total.powerErrors[p] += result.powerErrors[p] / this->columnResults.size();
+			}
+			for (size_t i = 0; i <= width; ++i) {
+				total.trailingRaw[i] += result.trailingRaw[i];
+				total.trailingAddition[i] += result.trailingAddition[i];
+			}
 		}
 
+		columnPlan winner = scorePlan(candidatePlans(total, this->maxInDataset - this->minInDataset));
+		this->selectedScheme = winner.selected;
+		this->finalM = winner.M;
+		this->finalP = winner.P;
+		this->finalPoFive = winner.poFive;
 	}
 
-	void slavePerformPowersOfFive(size_t threadIdx, float multiplier) {
+	/*
+	* Replaces the trailing run proxy by measured bytes: every candidate of a column is applied to a copy
+	* of the analysed sample of that column, which is measured with measureCompressibility, and the candidate
+	* with the smallest compressed size becomes the plan of the column. Candidates are measured in parallel.
+	*/
+	void estimateColumnPlans() {
+
+		if (this->howManyToTest == 0 || this->columnCandidates.empty()) {
+			return;
+		}
+
+		/* the sampled blocks of all row groups in one input, so matches across groups count as on export */
+		std::vector<std::vector<T>> samples(this->columnCandidates.size());
+		trPool->parallelFor(samples.size(), [this, &samples](size_t c, size_t) {
+			samples[c] = columnSample(c);
+		});
+
+		std::vector<std::pair<size_t, size_t>> candidates;
+		for (size_t c = 0; c < this->columnCandidates.size(); ++c) {
+			for (size_t k = 0; k < this->columnCandidates[c].size(); ++k) {
+				candidates.push_back({ c, k });
+			}
+		}
 
-		for(auto & f: this->floatResults[threadIdx]){
-			f *= multiplier;
+		trPool->parallelFor(candidates.size(), [this, &samples, &candidates](size_t idx, size_t) {
+			auto [c, k] = candidates[idx];
+			estimateCandidate(samples[c], this->columnCandidates[c][k]);
+		});
 
-			uint32_t* floatAsInt = reinterpret_cast<uint32_t*>(&f);
-			std::bitset<32> bit(*floatAsInt);
-			if (bit[0] != bit[1]) {
-				bit[0].flip();
+		for (size_t c = 0; c < this->columnCandidates.size(); ++c) {
+			const columnPlan* best = &this->columnCandidates[c][0];
+			for (const columnPlan& candidate : this->columnCandidates[c]) {
+				if (candidate.estimate.compressedBytes < best->estimate.compressedBytes) {
+					best = &candidate;
+				}
 			}
+			this->columnPlans[c] = *best;
+		}
+	}
+
+	/* Values of column c in the sampled blocks of every row group, in group order */
+	std::vector<T> columnSample(size_t c) {
+
+		std::vector<T> sample;
+		for (size_t g = 0; g < this->sampleBlocks.size(); ++g) {
+			columnSpan<T> column = this->floatColumns.groups[g].column(c);
+			size_t planned = std::min(this->sampleBlocks[g].size(), (size_t(1) << this->analysisRounds) - 1);
+			for (size_t k = 0; k < planned; ++k) {
+				auto [first, last] = blockRows(g, k);
+				for (size_t i = first; i < last; ++i) {
+					sample.push_back(column[i]);
+				}
+			}
+		}
+		return sample;
+	}
+
+	/* Measures candidate applied to a copy of sample */
+	void estimateCandidate(const std::vector<T>& sample, columnPlan& candidate) {
+
+		candidate.estimate = compressibility<width>();
+		if (sample.empty()) {
+			return;
+		}
+
+		std::vector<T> transformed = sample;
+		std::vector<uint8_t> scratch;
+		applyPlan({ transformed.data(), transformed.size(), 1 }, candidate);
+		measureCompressibility(reinterpret_cast<const bits*>(transformed.data()), transformed.size(), candidate.estimate, scratch);
+	}
+
+	/* Applies the plan of every column to all row groups */
+	void masterApplyPlans() {
+
+		trPool->parallelFor(floatColumns.groups.size(), [this](size_t groupIdx, size_t) {
+			applyScheme(groupIdx);
+		});
+
+	}
+
+	void slavePerformAddition(columnSpan<T> column, T bias) {
 
+		for (size_t i = 0; i < column.size(); ++i) {
+			column[i] += bias;
+		}
+
+	}
+
+	void slavePerformMultiplication(columnSpan<T> column, size_t M, size_t P) {
+
+		bits patternPrep = ~bits(0) << P;
+
+		bits patternToEnforce = floatTraits<T>::pattern(M) >> (width - P);
 
+		multiplicationKernels<T>::forM(M).apply(column.data, column.size(), column.stride, M, patternPrep, patternToEnforce);
+
+	}
+
+	void slavePerformPowersOfFive(columnSpan<T> column, T multiplier) {
+
+		for (size_t i = 0; i < column.size(); ++i) {
+			column[i] *= multiplier;
 		}
 
 	}
 	void exportPreprocessedFile() {
-		std::string fileName = "preprocessed_output.csv";
+		std::string fileName = this->outputFilename;
 		std::ofstream file(fileName);
 
 		if (!file.is_open()) {
@@ -783,53 +1925,250 @@ public:
 			return;
 		}
 		std::cout << "\nExporting preprocessed file to " << fileName << "\n - Progress - " << std::endl;
-		// Construct header row
-		std::string headerRow;
-		for (int i = 0; i < this->amountOfColumns - 1; ++i) {
-			headerRow += this->Headers[i] + ",";
+		if (this->hasHeader) {
+			file << headerRow() << "\n";
 		}
-		headerRow += this->Headers[this->amountOfColumns - 1];
-		file << headerRow << "\n";
 
-		float vectors = static_cast<float>(this->floatResults.size());
+		this->outputBuffer.reserve(this->chunkBytes);
+
+		float vectors = static_cast<float>(this->floatColumns.groups.size());
 		
 		float progressCounter = 0.0f;
 		
-		printProgressBar(0.0f);
+		/* A file with only a header has no rows, and no progress to show */
+		if (vectors > 0.0f) {
+			printProgressBar(0.0f);
+		}
 		//main loop
-		for (const auto vec : this->floatResults) {
+		for (size_t i = 0; i < this->floatColumns.groups.size(); ++i) {
+			
+			formatChunk(i, this->outputBuffer);
+			file << this->outputBuffer;
+
+			progressCounter += 1.0f;
+			float progress = progressCounter / vectors;
 			
-			std::ostringstream row;
+			printProgressBar(progress);
+
+		}
 
-			int counter = 1;
+		file.close();
+	}
+
+	std::string headerRow() {
+		std::string headerRow;
+		for (int i = 0; i < this->amountOfColumns - 1; ++i) {
+			headerRow += quoteHeader(this->Headers[i]) + ",";
+		}
+		headerRow += quoteHeader(this->Headers[this->amountOfColumns - 1]);
+		return headerRow;
+	}
+
+	/* Quotes a header that would otherwise split or end the header row of the output */
+	static std::string quoteHeader(const std::string& header) {
+		if (header.find_first_of(",\"\r\n") == std::string::npos) {
+			return header;
+		}
+		std::string text = "\"";
+		for (char c : header) {
+			text.push_back(c);
+			if (c == '"') {
+				text.push_back('"');
+			}
+		}
+		return text + "\"";
+	}
+
+	/*
+	* Formats the rows of a group into text, missing values are written as empty fields.
+	* The text keeps its capacity, so a recycled buffer does not allocate again. %.32g prints
+	* exactly what a stream with setprecision(32) prints.
+	*/
+	void formatChunk(size_t groupIdx, std::string& text) {
+
+		const rowGroup<T>& group = this->floatColumns.groups[groupIdx];
+		char number[64];
+
+		text.clear();
+
+		for (size_t r = 0; r < group.rows; ++r) {
+
+			for (size_t c = 0; c < this->amountOfColumns; ++c) {
+
+				T f = group.columns[c][r * group.stride];
+				if (!std::isnan(f)) {
+					int length = std::snprintf(number, sizeof(number), "%.32g", static_cast<double>(f));
+					text.append(number, length);
+				}
+				text.push_back(c + 1 == this->amountOfColumns ? '\n' : ',');
+
+			}
+
+		}
+
+	}
+
+	/* Swaps the columns and the export buffer with buffers, so a batch reuses them for the next file */
+	void swapBuffers(batchBuffers<T>& buffers) {
+		this->floatColumns.swap(buffers.columns);
+		this->outputBuffer.swap(buffers.text);
+	}
+
+	/*
+	* Parses the first sampleBytes of the file so the scheme can be decided before streaming.
+	* The whole sample is analysed, the -s percentage only applies to fully loaded datasets.
+	*/
+	void loadSample() {
+
+		const char* start = file.charMap;
+		const char* end = static_cast<const char*>(file.map) + file.length;
+
+		this->sampleBytes = this->rssBudget / 4;
+		if (this->sampleBytes < static_cast<size_t>(end - start)) {
+			strvw sample(start, this->sampleBytes);
+			size_t position = unquotedBreak(start, sample.find_last_of(this->lineBreak));
+			if (position != strvw::npos) {
+				end = start + position;
+			}
+		}
+		this->sampleBytes = end - start;
+
+		startCastingProcess(start, end);
+		this->defaultTestSizePercent = 100;
+
+	}
+
+	/* Transforms every column of a group with its plan */
+	void applyScheme(size_t groupIdx) {
+
+		rowGroup<T>& group = this->floatColumns.groups[groupIdx];
+
+		for (size_t c = 0; c < this->amountOfColumns && c < this->columnPlans.size(); ++c) {
+			applyPlan(group.column(c), this->columnPlans[c]);
+		}
+	}
 
-			for (const auto f : vec) {
+	void applyPlan(columnSpan<T> column, const columnPlan& plan) {
+
+		switch (plan.selected) {
+		case addition:
+			slavePerformAddition(column, plan.bias);
+			break;
+		case multiplication:
+			slavePerformMultiplication(column, plan.M, plan.P);
+			break;
+		case powersOfFive:
+			slavePerformPowersOfFive(column, plan.poFive);
+			break;
+		default:
+			break;
+		}
+	}
 
-				if (counter == this->amountOfColumns) {
-					
-					row << std::setprecision(32) << f << "\n";
-					file << row.str();
+	/*
+	* Streams the file through parse -> transform -> format -> write in windows sized from rssBudget.
+	* Every window in flight holds its input pages, its floats (about half the text size) and its
+	* formatted output (about three times the text size), at most streamQueueDepth windows wait for
+	* the writer and the parser blocks until the writer catches up.
+	*/
+	void streamPreprocessedFile() {
+
+		std::ofstream out(this->outputFilename, std::ios::binary);
+		if (!out.is_open()) {
+			std::cerr << "Unable to open file" << std::endl;
+			return;
+		}
+		if (this->hasHeader) {
+			out << headerRow() << "\n";
+		}
 
-					counter = 1;
-					row.str("");
-					
-					
+		this->actualSize = 0;
+
+		size_t windowBytes = this->rssBudget / (5 * (this->streamQueueDepth + 1));
+		if (windowBytes < this->chunkBytes) {
+			windowBytes = this->chunkBytes;
+		}
+		size_t maxWindowBytes = std::max(windowBytes, this->rssBudget / 5);
+
+		std::deque<std::vector<std::string>> pendingWrites;
+		std::mutex queueMtx;
+		std::condition_variable queueCv;
+		bool finished = false;
+
+		std::thread writer([&]() {
+			while (true) {
+				std::vector<std::string> window;
+				{
+					std::unique_lock<std::mutex> lock(queueMtx);
+					queueCv.wait(lock, [&] { return finished || !pendingWrites.empty(); });
+					if (pendingWrites.empty()) {
+						return;
+					}
+					window = std::move(pendingWrites.front());
+					pendingWrites.pop_front();
 				}
-				else {
-					row << std::setprecision(32) << f << ",";
-					++counter;
+				queueCv.notify_all();
+				for (const auto& text : window) {
+					out << text;
 				}
-				
 			}
-			progressCounter += 1.0f;
-			float progress = progressCounter / vectors;
-			
-			printProgressBar(progress);
+		});
+
+		const char* start = file.charMap;
+		const char* end = static_cast<const char*>(file.map) + file.length;
+
+		while (start < end) {
+
+			/* A window without an unquoted line break doubles until it holds a whole row, up to maxWindowBytes */
+			const char* windowEnd = end;
+			size_t span = windowBytes;
+			while (static_cast<size_t>(end - start) > span) {
+				loadUntil(start + span);
+				size_t position = unquotedBreak(start, strvw(start, span).find_last_of(this->lineBreak));
+				if (position != strvw::npos) {
+					windowEnd = start + position;
+					break;
+				}
+				if (span == maxWindowBytes) {
+					break;
+				}
+				span = std::min(2 * span, maxWindowBytes);
+			}
+			if (windowEnd == end && static_cast<size_t>(end - start) > span) {
+				std::cerr << "A row is larger than the streaming budget, raise it with -r" << std::endl;
+				break;
+			}
+
+			startCastingProcess(start, windowEnd);
+
+			std::vector<std::string> texts(this->floatColumns.groups.size());
+			trPool->parallelFor(this->floatColumns.groups.size(), [&](size_t groupIdx, size_t) {
+				applyScheme(groupIdx);
+				formatChunk(groupIdx, texts[groupIdx]);
+			});
+
+			release_file_range(const_cast<char*>(start), windowEnd - start);
 
+			{
+				std::unique_lock<std::mutex> lock(queueMtx);
+				queueCv.wait(lock, [&] { return pendingWrites.size() < this->streamQueueDepth; });
+				pendingWrites.push_back(std::move(texts));
+			}
+			queueCv.notify_all();
+
+			start = windowEnd + 1;
 		}
 
-		file.close();
+		{
+			std::lock_guard<std::mutex> lock(queueMtx);
+			finished = true;
+		}
+		queueCv.notify_all();
+		writer.join();
+
+		this->floatColumns.release();
 	}
+
 	void printProgressBar(float progress) {
 		int barWidth = 70;
 		std::cout << "[";
@@ -877,7 +2216,7 @@ public:
 		std::ofstream multFile(multFilename);
 
 		std::string header = "M,P,MSE,Max%dev";
-		for (int i = 1; i < 33; ++i) {
+		for (size_t i = 1; i <= width; ++i) {
 			header += "," + std::to_string(i);
 		}
 		multFile << header << "\n";
@@ -887,7 +2226,7 @@ public:
 			multFile << mu.first.first << "," << mu.first.second << "," << std::scientific << mu.second.mse << "," << mu.second.maxRelativeDeviation;
 
 			std::string row = "";
-			for (int i = 1; i < 33; ++i) {
+			for (size_t i = 1; i <= width; ++i) {
 				row += "," + std::to_string(mu.second.tralingSymbols[i]);
 			}
 			multFile << row << "\n";
@@ -898,27 +2237,53 @@ public:
 		std::ofstream po5File(po5Filename);
 
 		header = "Power/Trailing";
-		for (int i = 1; i < 33; ++i) {
+		for (size_t i = 1; i <= width; ++i) {
 			header += "," + std::to_string(i);
 		}
 		po5File << header << "\n";
 
 		po5File << "1";
-		for (int i = 1; i < 33; ++i) {
+		for (size_t i = 1; i <= width; ++i) {
 			po5File << "," << this->Trailing5[i];
 		}
 		po5File << "\n2";
 		
-		for (int i = 1; i < 33; ++i) {
+		for (size_t i = 1; i <= width; ++i) {
 			po5File << "," << this->Trailing25[i];
 		}
 		po5File << "\n3";
-		for (int i = 1; i < 33; ++i) {
+		for (size_t i = 1; i <= width; ++i) {
 			po5File << "," << this->Trailing125[i];
 		}
 
 		po5File.close();
 
+		std::ofstream columnFile(reportDir + "/columns.csv");
+
+		columnFile << "Column,Scheme,M,P,Bias,Power,MeanTrailing,RelativeError,AdditionError,Max,Min\n";
+		for (size_t c = 0; c < this->columnPlans.size(); ++c) {
+			const columnPlan& plan = this->columnPlans[c];
+			columnFile << (c < this->Headers.size() ? this->Headers[c] : std::to_string(c)) << "," << schemeName(plan.selected) << ","
+				<< plan.M << "," << plan.P << "," << plan.bias << "," << plan.poFive << "," << plan.meanTrailing << "," << plan.relativeError << ","
+				<< (c < this->columnResults.size() ? this->columnResults[c].error : T(0)) << ","
+				<< (c < this->columnMax.size() ? this->columnMax[c] : T(0)) << "," << (c < this->columnMin.size() ? this->columnMin[c] : T(0)) << "\n";
+		}
+
+		columnFile.close();
+
+		std::ofstream candidateFile(reportDir + "/candidates.csv");
+
+		candidateFile << "Column,Scheme,M,P,Bias,Power,MeanTrailing,RelativeError,ByteEntropy,BitPlaneEntropy,CompressedBits\n";
+		for (size_t c = 0; c < this->columnCandidates.size(); ++c) {
+			for (const columnPlan& plan : this->columnCandidates[c]) {
+				candidateFile << (c < this->Headers.size() ? this->Headers[c] : std::to_string(c)) << "," << schemeName(plan.selected) << ","
+					<< plan.M << "," << plan.P << "," << plan.bias << "," << plan.poFive << "," << plan.meanTrailing << "," << plan.relativeError << ","
+					<< plan.estimate.byteEntropy() << "," << plan.estimate.bitPlaneEntropy() << "," << plan.estimate.compressedBitsPerValue() << "\n";
+			}
+		}
+
+		candidateFile.close();
+
 	}
 	
 };
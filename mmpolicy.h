@@ -0,0 +1,18 @@
+#ifndef MMPOLICY_H
+#define MMPOLICY_H
+
+/* Access policies for mmap_file, can be combined */
+#define MM_POLICY_NONE       0x0
+#define MM_POLICY_SEQUENTIAL 0x1
+#define MM_POLICY_WILLNEED   0x2
+#define MM_POLICY_POPULATE   0x4
+#define MM_POLICY_HUGEPAGE   0x8
+#define MM_POLICY_DIRECT     0x10
+#define MM_POLICY_WRITABLE   0x20
+
+/* How the file gets into memory */
+#define MM_BACKEND_MMAP      0
+#define MM_BACKEND_PREAD     1
+#define MM_BACKEND_URING     2
+
+#endif // !MMPOLICY_H
@@ -0,0 +1,129 @@
+#ifndef MULTIPLY_H
+#define MULTIPLY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <bit>
+#include <array>
+#include <utility>
+#include <algorithm>
+
+#include "floattraits.h"
+
+/*
+* Kernels of the multiplication scheme for one M. M is a template argument, so the multiplier is a
+* constant, the loops have no calls or branches left and the compiler vectorises them. M = 0 is the
+* generic kernel that takes the multiplier at run time. P only sets the two masks, which are loop
+* invariant either way: prep clears the low P bits and enforce writes the leading bits of 1/M into
+* them. Zeroes are not transformed.
+*/
+template<typename T, size_t M>
+struct multiplicationKernel {
+
+	typedef typename floatTraits<T>::bits bits;
+
+	/* Lanes of the reductions, one 512 bit vector of T */
+	static constexpr size_t lanes = 64 / sizeof(T);
+
+	/* Transforms n values, element i at values[i * stride] */
+	static void apply(T* values, size_t n, size_t stride, size_t multiplier, bits prep, bits enforce) {
+
+		const T m = static_cast<T>(M ? M : multiplier);
+
+		if (stride == 1) {
+			for (size_t i = 0; i < n; ++i) {
+				T x = values[i];
+				T product = std::bit_cast<T>((std::bit_cast<bits>(x) & prep) | enforce) * m;
+				values[i] = x != 0 ? product : x;
+			}
+			return;
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			T& x = values[i * stride];
+			if (x != 0) {
+				x = std::bit_cast<T>((std::bit_cast<bits>(x) & prep) | enforce) * m;
+			}
+		}
+	}
+
+	/*
+	* Evaluates a tile of n values without NaN. The bits of the products go to transformed, zeroes stay 0
+	* and so count as a full trailing run. The squared deviations of undoing the product are added to
+	* squaredError, the largest deviation relative to the value is kept in maxRelativeDeviation.
+	*/
+	static void analyze(const T* tile, size_t n, size_t multiplier, bits prep, bits enforce, bits* transformed, double& squaredError, T& maxRelativeDeviation) {
+
+		const T m = static_cast<T>(M ? M : multiplier);
+
+		double squares[lanes] = {};
+		T largest[lanes] = {};
+
+		auto step = [&](size_t i, double& square, T& relative) {
+			T x = tile[i];
+			bool zero = x == 0;
+			T product = std::bit_cast<T>((std::bit_cast<bits>(x) & prep) | enforce) * m;
+			T deviation = zero ? T(0) : product / m - x;
+			transformed[i] = zero ? bits(0) : std::bit_cast<bits>(product);
+			square += static_cast<double>(deviation) * deviation;
+			relative = std::max(relative, zero ? T(0) : std::abs(deviation / x));
+		};
+
+		size_t i = 0;
+		for (; i + lanes <= n; i += lanes) {
+			for (size_t j = 0; j < lanes; ++j) {
+				step(i + j, squares[j], largest[j]);
+			}
+		}
+		for (; i < n; ++i) {
+			step(i, squares[0], largest[0]);
+		}
+
+		for (size_t j = 0; j < lanes; ++j) {
+			squaredError += squares[j];
+			maxRelativeDeviation = std::max(maxRelativeDeviation, largest[j]);
+		}
+	}
+
+};
+
+/*
+* The kernels of the odd M up to specializedM, generated at compile time, and the generic kernel for
+* the larger M with a pattern. Looked up once per column.
+*/
+template<typename T>
+struct multiplicationKernels {
+
+	typedef typename floatTraits<T>::bits bits;
+	typedef void (*applyKernel)(T*, size_t, size_t, size_t, bits, bits);
+	typedef void (*analyzeKernel)(const T*, size_t, size_t, bits, bits, bits*, double&, T&);
+
+	struct entry {
+		applyKernel apply;
+		analyzeKernel analyze;
+	};
+
+	static constexpr size_t specializedM = 31;
+
+	static constexpr bool supports(size_t M) {
+		return floatTraits<T>::supportsM(M);
+	}
+
+	static const entry& forM(size_t M) {
+		return M <= specializedM ? table[(M - 3) / 2] : generic;
+	}
+
+private:
+
+	template<size_t... K>
+	static constexpr std::array<entry, sizeof...(K)> generate(std::index_sequence<K...>) {
+		return { { { &multiplicationKernel<T, 2 * K + 3>::apply, &multiplicationKernel<T, 2 * K + 3>::analyze }... } };
+	}
+
+	static constexpr std::array<entry, (specializedM - 1) / 2> table = generate(std::make_index_sequence<(specializedM - 1) / 2>());
+	static constexpr entry generic = { &multiplicationKernel<T, 0>::apply, &multiplicationKernel<T, 0>::analyze };
+
+};
+
+#endif // !MULTIPLY_H
@@ -0,0 +1,117 @@
+#ifndef NPY_H
+#define NPY_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <cstddef>
+
+/* Header of a NumPy .npy file, see numpy.lib.format */
+struct npyHeader {
+	bool valid = false;
+	size_t dataOffset = 0;
+	size_t elementSize = 0;
+	bool fortranOrder = false;
+	std::string descr;
+	std::vector<size_t> shape;
+};
+
+/* Reads the value of key from the header dictionary, e.g. 'descr': '<f4' */
+inline std::string npyField(const std::string& dict, const std::string& key) {
+	size_t position = dict.find("'" + key + "'");
+	if (position == std::string::npos) {
+		return "";
+	}
+	position = dict.find(':', position);
+	if (position == std::string::npos) {
+		return "";
+	}
+	++position;
+	while (position < dict.size() && dict[position] == ' ') {
+		++position;
+	}
+	size_t end = position;
+	if (dict[position] == '(') {
+		end = dict.find(')', position) + 1;
+	}
+	else if (dict[position] == '\'') {
+		end = dict.find('\'', position + 1) + 1;
+	}
+	else {
+		end = dict.find_first_of(",}", position);
+	}
+	return dict.substr(position, end - position);
+}
+
+/* Only little endian float32 and float64 arrays with one or two dimensions are accepted */
+inline npyHeader parseNpyHeader(const char* data, size_t length) {
+
+	npyHeader header;
+
+	if (length < 10 || std::memcmp(data, "\x93NUMPY", 6) != 0) {
+		return header;
+	}
+
+	unsigned char major = static_cast<unsigned char>(data[6]);
+	size_t dictLength = 0;
+	size_t dictStart = 0;
+	if (major == 1) {
+		dictLength = static_cast<unsigned char>(data[8]) | static_cast<unsigned char>(data[9]) << 8;
+		dictStart = 10;
+	}
+	else if (length >= 12) {
+		for (int i = 3; i >= 0; --i) {
+			dictLength = dictLength << 8 | static_cast<unsigned char>(data[8 + i]);
+		}
+		dictStart = 12;
+	}
+	if (dictLength == 0 || dictStart + dictLength > length) {
+		return header;
+	}
+
+	std::string dict(data + dictStart, dictLength);
+	header.dataOffset = dictStart + dictLength;
+	header.descr = npyField(dict, "descr");
+	header.fortranOrder = npyField(dict, "fortran_order") == "True";
+
+	if (header.descr == "'<f4'") {
+		header.elementSize = 4;
+	}
+	else if (header.descr == "'<f8'") {
+		header.elementSize = 8;
+	}
+	else {
+		return header;
+	}
+
+	std::string shape = npyField(dict, "shape");
+	size_t value = 0;
+	bool digits = false;
+	for (char c : shape) {
+		if (c >= '0' && c <= '9') {
+			value = value * 10 + (c - '0');
+			digits = true;
+		}
+		else if (digits) {
+			header.shape.push_back(value);
+			value = 0;
+			digits = false;
+		}
+	}
+
+	header.valid = header.shape.size() == 1 || header.shape.size() == 2;
+	return header;
+}
+
+/* Element size of a .npy file without mapping it, 0 if the header is not supported */
+inline size_t npyElementSize(const std::string& filename) {
+
+	std::ifstream in(filename, std::ios::binary);
+	std::string head(4096, '\0');
+	in.read(head.data(), head.size());
+	npyHeader header = parseNpyHeader(head.data(), static_cast<size_t>(in.gcount()));
+	return header.valid ? header.elementSize : 0;
+}
+
+#endif // !NPY_H
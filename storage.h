@@ -0,0 +1,259 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <map>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/* Values of one column of a row group, element i is data[i * stride] */
+template<typename T>
+struct columnSpan {
+	T* data;
+	size_t rows;
+	size_t stride;
+
+	T& operator[](size_t i) const {
+		return data[i * stride];
+	}
+
+	size_t size() const {
+		return rows;
+	}
+};
+
+/*
+* Rows [firstRow, firstRow + rows) of the dataset. Row i of column c is columns[c][i * stride],
+* the stride is 1 for owned columns and the amount of columns for row major binary input used in place.
+* Owned columns live in one allocation of the block pool of the worker that filled the group.
+*/
+template<typename T>
+struct rowGroup {
+	size_t firstRow = 0;
+	size_t rows = 0;
+	size_t stride = 1;
+	std::vector<T*> columns;
+
+	void* block = nullptr;
+	size_t blockBytes = 0;
+	size_t pool = 0;
+
+	columnSpan<T> column(size_t c) const {
+		return { columns[c], rows, stride };
+	}
+};
+
+/*
+* Memory of one worker handed out in whole blocks of blockBytes and never initialised.
+* Returned allocations are kept and serve later requests of up to the same size, the pool
+* only grows when nothing fits and gives everything back to the system when it is destroyed.
+*/
+struct blockPool {
+
+	size_t blockBytes;
+	bool hugepage;
+	std::multimap<size_t, void*> spare;
+	std::vector<std::pair<void*, size_t>> owned;
+
+	blockPool(size_t blockBytes, bool hugepage) : blockBytes(blockBytes), hugepage(hugepage) {
+	}
+	blockPool(const blockPool&) = delete;
+	blockPool& operator=(const blockPool&) = delete;
+
+	~blockPool() {
+		for (auto& allocation : owned) {
+			unmapBlocks(allocation.first, allocation.second);
+		}
+	}
+
+	/* Rounds bytes up to whole blocks, a spare allocation is reused if it is at most twice as large */
+	void* acquire(size_t& bytes) {
+
+		bytes = (bytes + blockBytes - 1) / blockBytes * blockBytes;
+		if (bytes == 0) {
+			bytes = blockBytes;
+		}
+
+		auto it = spare.lower_bound(bytes);
+		if (it != spare.end() && it->first <= 2 * bytes) {
+			bytes = it->first;
+			void* block = it->second;
+			spare.erase(it);
+			return block;
+		}
+
+		void* block = mapBlocks(bytes);
+		owned.push_back({ block, bytes });
+		return block;
+	}
+
+	void giveBack(void* block, size_t bytes) {
+		spare.emplace(bytes, block);
+	}
+
+private:
+
+	void* mapBlocks(size_t bytes) {
+#ifdef _WIN32
+		void* block = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (block == NULL) {
+			throw std::bad_alloc();
+		}
+#else
+		void* block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (block == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+#ifdef MADV_HUGEPAGE
+		if (hugepage) {
+			madvise(block, bytes, MADV_HUGEPAGE);
+		}
+#endif
+#endif
+		return block;
+	}
+
+	static void unmapBlocks(void* block, size_t bytes) {
+#ifdef _WIN32
+		VirtualFree(block, 0, MEM_RELEASE);
+#else
+		munmap(block, bytes);
+#endif
+	}
+
+};
+
+/*
+* Structure of arrays storage split into row groups, one per parsing chunk. Every group keeps its
+* columns in one allocation taken from the pool of the worker that parses it, so the memory is
+* first touched, and placed on the NUMA node of, that worker and is recycled by the next window or file.
+*/
+template<typename T>
+struct columnStore {
+
+	static constexpr size_t alignment = 64;
+
+	size_t blockBytes = 1024 * 1024;
+	bool hugepage = false;
+
+	size_t amountOfColumns = 0;
+	std::vector<rowGroup<T>> groups;
+	std::vector<std::unique_ptr<blockPool>> pools;
+
+	columnStore() = default;
+	columnStore(const columnStore&) = delete;
+	columnStore& operator=(const columnStore&) = delete;
+
+	~columnStore() {
+		release();
+	}
+
+	/* Creates one group per entry of rowCounts without memory, allocate gives a group its columns */
+	void partition(size_t amountOfColumns, const std::vector<size_t>& rowCounts, size_t workers) {
+
+		release();
+		this->amountOfColumns = amountOfColumns;
+
+		while (pools.size() < workers) {
+			pools.push_back(std::make_unique<blockPool>(hugepage ? 2 * blockBytes : blockBytes, hugepage));
+		}
+
+		groups.resize(rowCounts.size());
+
+		size_t offset = 0;
+		for (size_t i = 0; i < rowCounts.size(); ++i) {
+			rowGroup<T>& group = groups[i];
+			group.firstRow = offset;
+			group.rows = rowCounts[i];
+			group.stride = 1;
+			group.columns.assign(amountOfColumns, nullptr);
+			offset += rowCounts[i];
+		}
+	}
+
+	/* Takes the columns of a group from the pool of workerIdx, has to run on that worker */
+	void allocate(size_t groupIdx, size_t workerIdx) {
+
+		rowGroup<T>& group = groups[groupIdx];
+		size_t columnBytes = (group.rows * sizeof(T) + alignment - 1) / alignment * alignment;
+
+		group.pool = workerIdx;
+		group.blockBytes = columnBytes * amountOfColumns;
+		group.block = pools[workerIdx]->acquire(group.blockBytes);
+
+		for (size_t c = 0; c < amountOfColumns; ++c) {
+			group.columns[c] = reinterpret_cast<T*>(static_cast<char*>(group.block) + c * columnBytes);
+		}
+	}
+
+	/*
+	* Uses rows x amountOfColumns values that live elsewhere (e.g. a mapped binary file) without copying,
+	* split into groups of groupRows rows. Column major data has contiguous columns, row major data is strided.
+	*/
+	void view(T* base, size_t rows, size_t amountOfColumns, bool columnMajor, size_t groupRows) {
+
+		release();
+		this->amountOfColumns = amountOfColumns;
+
+		if (groupRows == 0) {
+			groupRows = 1;
+		}
+
+		for (size_t first = 0; first < rows; first += groupRows) {
+			rowGroup<T> group;
+			group.firstRow = first;
+			group.rows = rows - first < groupRows ? rows - first : groupRows;
+			group.stride = columnMajor ? 1 : amountOfColumns;
+			group.columns.resize(amountOfColumns);
+			for (size_t c = 0; c < amountOfColumns; ++c) {
+				group.columns[c] = columnMajor ? base + c * rows + first : base + first * amountOfColumns + c;
+			}
+			groups.push_back(std::move(group));
+		}
+	}
+
+	size_t rows() const {
+		size_t total = 0;
+		for (const auto& group : groups) {
+			total += group.rows;
+		}
+		return total;
+	}
+
+	/* Exchanges the groups and pools with other, used to hand them from one file to the next */
+	void swap(columnStore& other) {
+		std::swap(amountOfColumns, other.amountOfColumns);
+		groups.swap(other.groups);
+		pools.swap(other.pools);
+	}
+
+	/* Returns the memory of every group to its pool, the pools keep it for the next partition */
+	void release() {
+		for (auto& group : groups) {
+			if (group.block) {
+				pools[group.pool]->giveBack(group.block, group.blockBytes);
+			}
+		}
+		groups.clear();
+		amountOfColumns = 0;
+	}
+
+};
+
+/* Allocations that outlive a single file in batch mode: the columns and the text buffer of the export */
+template<typename T>
+struct batchBuffers {
+	columnStore<T> columns;
+	std::string text;
+};
+
+#endif // !STORAGE_H
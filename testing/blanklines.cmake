@@ -0,0 +1,65 @@
+# Regression check for blank lines between rows: they must not be counted as rows,
+# must not change the preprocessed output and must not enlarge the analysed sample,
+# with \n and with \r\n line endings.
+# Usage: cmake -DEXPE=<path to expe> -DWORK=<scratch directory> -P blanklines.cmake
+
+set(rows 20000)
+set(columns 4)
+
+set(variants single double crlfSingle crlfDouble)
+foreach(variant ${variants})
+	file(MAKE_DIRECTORY ${WORK}/${variant})
+endforeach()
+
+set(single "a,b,c,d\n")
+set(double "a,b,c,d\n")
+set(crlfSingle "a,b,c,d\r\n")
+set(crlfDouble "a,b,c,d\r\n")
+foreach(i RANGE 1 ${rows})
+	math(EXPR a "(${i} * 7919) % 100000")
+	math(EXPR b "(${i} * 104729) % 1000 - 500")
+	math(EXPR d "(${i} * 31) % 10000")
+	set(line "${a}.${i},${b}.5,${i},0.${d}")
+	string(APPEND single "${line}\n")
+	string(APPEND double "${line}\n\n")
+	string(APPEND crlfSingle "${line}\r\n")
+	string(APPEND crlfDouble "${line}\r\n\r\n")
+endforeach()
+
+foreach(variant ${variants})
+	file(WRITE ${WORK}/${variant}/input.csv "${${variant}}")
+	file(REMOVE ${WORK}/${variant}/preprocessed_output.csv)
+	execute_process(
+		COMMAND ${EXPE} -f input.csv -t 4 -m -z
+		WORKING_DIRECTORY ${WORK}/${variant}
+		OUTPUT_VARIABLE output
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${variant}: expe failed with ${result}")
+	endif()
+
+	math(EXPR values "${rows} * ${columns}")
+	if(NOT output MATCHES "Amount of floats: ${values} ")
+		message(FATAL_ERROR "${variant}: expected ${values} parsed values")
+	endif()
+
+	file(MD5 ${WORK}/${variant}/preprocessed_output.csv ${variant}Output)
+
+	execute_process(
+		COMMAND ${EXPE} -f input.csv -t 4 -z
+		WORKING_DIRECTORY ${WORK}/${variant}
+		OUTPUT_VARIABLE output
+		RESULT_VARIABLE result
+	)
+	string(REGEX MATCH "Sampled values in [0-9]+ rounds *\\| *[0-9]+ *\\| *([0-9]+)" sampled "${output}")
+	if(NOT result EQUAL 0 OR NOT sampled OR CMAKE_MATCH_1 GREATER values)
+		message(FATAL_ERROR "${variant}: sampled ${CMAKE_MATCH_1} of ${values} values")
+	endif()
+endforeach()
+
+foreach(variant double crlfSingle crlfDouble)
+	if(NOT singleOutput STREQUAL ${variant}Output)
+		message(FATAL_ERROR "${variant}: blank lines or line endings changed the preprocessed output")
+	endif()
+endforeach()
@@ -0,0 +1,76 @@
+/*
+* Checks that lzCompressedSize gives the size LZ4_compress_default produces, on short inputs, on both
+* sides of the 64 KiB switch of the hash table, and on data shuffled the way measureCompressibility does.
+*/
+#include "estimator.h"
+
+#include <lz4.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool sameSize(const std::string& name, const std::vector<uint8_t>& data) {
+
+	std::vector<char> compressed(LZ4_compressBound(static_cast<int>(data.size())));
+	int expected = LZ4_compress_default(reinterpret_cast<const char*>(data.data()), compressed.data(), static_cast<int>(data.size()), static_cast<int>(compressed.size()));
+	size_t estimated = lzCompressedSize(data.data(), data.size());
+
+	if (estimated != static_cast<size_t>(expected)) {
+		std::cerr << name << " of " << data.size() << " bytes: lz4 " << expected << ", estimate " << estimated << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main() {
+
+	std::mt19937 rng(11);
+	bool ok = true;
+
+	std::vector<size_t> sizes{ 0, 1, 12, 13, 14, 100, 4096, 65535, 65546, 65547, 65548, 200000, 1 << 20 };
+
+	for (size_t n : sizes) {
+
+		std::vector<uint8_t> data(n);
+
+		for (auto& byte : data) {
+			byte = static_cast<uint8_t>(rng());
+		}
+		ok &= sameSize("random", data);
+
+		for (auto& byte : data) {
+			byte = static_cast<uint8_t>(rng() % 4);
+		}
+		ok &= sameSize("four symbols", data);
+
+		std::fill(data.begin(), data.end(), uint8_t(7));
+		ok &= sameSize("constant", data);
+
+		/* repeats of a block longer than the 64 KiB window, with a few changed bytes */
+		std::vector<uint8_t> block(70000);
+		for (auto& byte : block) {
+			byte = static_cast<uint8_t>(rng());
+		}
+		for (size_t i = 0; i < n; ++i) {
+			data[i] = rng() % 97 ? block[i % block.size()] : static_cast<uint8_t>(rng());
+		}
+		ok &= sameSize("repeated block", data);
+
+		/* decimals with three digits, split into byte planes */
+		std::vector<float> values(n / 4);
+		for (auto& value : values) {
+			value = static_cast<float>(rng() % 100000) / 1000.0f;
+		}
+		compressibility<32> result;
+		std::vector<uint8_t> scratch;
+		measureCompressibility(reinterpret_cast<const uint32_t*>(values.data()), values.size(), result, scratch);
+		ok &= sameSize("shuffled decimals", scratch);
+	}
+
+	if (ok) {
+		std::cout << "lzCompressedSize matches LZ4_compress_default" << std::endl;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "topology.h"
+
+/*
+* Persistent pool of workers, each owning a deque of tasks.
+* A worker drains its own deque from the front and, once empty, steals from the back
+* of the other deques, so skewed tasks do not leave cores idle at the end of a phase.
+* Pinned workers only steal from workers on their own NUMA node, and only wake up for work queued there.
+* On hybrid processors the tasks are dealt in proportion to the throughput measured per core type.
+*/
+struct threadPool {
+
+	typedef std::function<void(size_t)> task;
+
+	struct worker {
+		std::deque<task> tasks;
+		std::mutex mtx;
+		std::thread thread;
+		int cpu = -1;
+		int node = 0;
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<int> kind{ unknownCore };
+		std::atomic<size_t> units{ 0 };
+		std::atomic<size_t> micros{ 0 };
+	};
+
+	size_t threads;
+	std::vector<std::unique_ptr<worker>> workers;
+	std::vector<cpuInfo> placement;
+
+	threadPool() {
+		this->threads = std::thread::hardware_concurrency() - 1;
+	}
+	threadPool(size_t threads) : threads(threads) {
+	};
+
+	~threadPool() {
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+			stopping = true;
+		}
+		sleepCv.notify_all();
+
+		for (auto& w : workers) {
+			if (w->thread.joinable()) {
+				w->thread.join();
+			}
+		}
+
+	}
+
+	void start() {
+		if (this->threads == 0) {
+			this->threads = 1;
+		}
+		for (size_t i = 0; i < threads; ++i) {
+			workers.push_back(std::make_unique<worker>());
+			if (!placement.empty()) {
+				workers[i]->cpu = placement[i % placement.size()].cpu;
+				workers[i]->node = placement[i % placement.size()].node;
+				workers[i]->kind = placement[i % placement.size()].kind;
+			}
+		}
+		for (size_t i = 0; i < threads; ++i) {
+			workers[i]->thread = std::thread(&threadPool::workerLoop, this, i);
+		}
+	}
+
+	/*
+	* Pins worker i to cpus[i % cpus.size()], has to be called before start. parallelFor deals task i
+	* to the same worker in every phase, so a slice is parsed and later transformed on the same node.
+	*/
+	void pin(std::vector<cpuInfo> cpus) {
+		this->placement = std::move(cpus);
+	}
+
+	/* Queues a task on the given worker, the task receives the index of the worker that runs it */
+	void submit(task t, size_t workerIdx) {
+		worker& w = *workers[workerIdx % threads];
+		++pending;
+		{
+			std::lock_guard<std::mutex> lock(w.mtx);
+			w.tasks.push_back(std::move(t));
+			++w.queued;
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+		}
+		sleepCv.notify_all();
+	}
+
+	void submit(task t) {
+		submit(std::move(t), nextWorker++);
+	}
+
+	/* Blocks until every submitted task has finished */
+	void wait() {
+		std::unique_lock<std::mutex> lock(sleepMtx);
+		doneCv.wait(lock, [this] { return pending.load() == 0; });
+	}
+
+	/*
+	* Runs fn(taskIdx, workerIdx) for every taskIdx in [0, tasks) and waits for all of them.
+	* Only these tasks are waited for, so calls from different threads share the pool without serialising.
+	* Consecutive tasks are dealt to the same worker so each one starts on a contiguous range.
+	* Must be called from outside the pool, a task waiting on the pool would never wake up.
+	*/
+	template<typename F>
+	void parallelFor(size_t tasks, F&& fn) {
+
+		if (tasks == 0) {
+			return;
+		}
+
+		std::shared_ptr<const std::vector<double>> prefix;
+		{
+			std::lock_guard<std::mutex> lock(weightMtx);
+			prefix = weightPrefix;
+		}
+
+		std::atomic<size_t> remaining{ tasks };
+		pending += tasks;
+		for (size_t i = 0; i < tasks; ++i) {
+			worker& w = *workers[ownerOf(i, tasks, *prefix)];
+			std::lock_guard<std::mutex> lock(w.mtx);
+			w.tasks.push_back([this, &fn, &remaining, i](size_t workerIdx) {
+				fn(i, workerIdx);
+				if (--remaining == 0) {
+					std::lock_guard<std::mutex> done(sleepMtx);
+					doneCv.notify_all();
+				}
+			});
+			++w.queued;
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+		}
+		sleepCv.notify_all();
+
+		std::unique_lock<std::mutex> lock(sleepMtx);
+		doneCv.wait(lock, [&remaining] { return remaining.load() == 0; });
+	}
+
+	/*
+	* Adds units of work done in micros microseconds to the statistics of a worker, called by the worker
+	* from inside a task. kind is the core type the task ran on, the last one reported sticks to the worker.
+	*/
+	void record(size_t workerIdx, int kind, size_t units, size_t micros) {
+		worker& w = *workers[workerIdx];
+		if (kind != unknownCore) {
+			w.kind = kind;
+		}
+		w.units += units;
+		w.micros += micros;
+	}
+
+	/*
+	* Weighs every worker by the throughput recorded for its core type, so parallelFor deals fewer
+	* tasks to slower cores. Without at least two core types with records the tasks stay evenly dealt.
+	*/
+	void reweigh() {
+
+		size_t units[coreKinds] = {};
+		size_t micros[coreKinds] = {};
+		for (auto& w : workers) {
+			units[w->kind] += w->units;
+			micros[w->kind] += w->micros;
+		}
+
+		size_t measured = 0;
+		for (size_t k = performanceCore; k < coreKinds; ++k) {
+			measured += micros[k] > 0;
+		}
+		auto prefix = std::make_shared<std::vector<double>>();
+		if (measured >= 2) {
+			double total = 0;
+			for (auto& w : workers) {
+				int kind = micros[w->kind] ? w->kind.load() : performanceCore;
+				total += static_cast<double>(units[kind]) / micros[kind];
+				prefix->push_back(total);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(weightMtx);
+		weightPrefix = std::move(prefix);
+	}
+
+	/* Splits [0, count) into ranges of at most grain elements, fn(begin, end, workerIdx) */
+	template<typename F>
+	void parallelRange(size_t count, size_t grain, F&& fn) {
+
+		if (grain == 0) {
+			grain = 1;
+		}
+		size_t tasks = (count + grain - 1) / grain;
+		parallelFor(tasks, [&](size_t taskIdx, size_t workerIdx) {
+			size_t begin = taskIdx * grain;
+			size_t end = begin + grain < count ? begin + grain : count;
+			fn(begin, end, workerIdx);
+		});
+	}
+
+private:
+
+	std::mutex sleepMtx;
+	std::condition_variable sleepCv;
+	std::condition_variable doneCv;
+	std::atomic<size_t> pending{ 0 };
+	std::atomic<size_t> nextWorker{ 0 };
+	bool stopping = false;
+	std::mutex weightMtx;
+	std::shared_ptr<const std::vector<double>> weightPrefix = std::make_shared<std::vector<double>>();
+
+	/* Worker that task taskIdx of tasks is dealt to, consecutive tasks go to the same worker */
+	size_t ownerOf(size_t taskIdx, size_t tasks, const std::vector<double>& weightPrefix) const {
+		if (weightPrefix.empty()) {
+			return taskIdx * threads / tasks;
+		}
+		double position = (taskIdx + 0.5) / tasks * weightPrefix.back();
+		size_t owner = std::upper_bound(weightPrefix.begin(), weightPrefix.end(), position) - weightPrefix.begin();
+		return owner < threads ? owner : threads - 1;
+	}
+
+	bool popLocal(size_t workerIdx, task& t) {
+		worker& w = *workers[workerIdx];
+		std::lock_guard<std::mutex> lock(w.mtx);
+		if (w.tasks.empty()) {
+			return false;
+		}
+		t = std::move(w.tasks.front());
+		w.tasks.pop_front();
+		--w.queued;
+		return true;
+	}
+
+	bool steal(size_t workerIdx, task& t) {
+		for (size_t i = 1; i < threads; ++i) {
+			worker& victim = *workers[(workerIdx + i) % threads];
+			if (victim.node != workers[workerIdx]->node) {
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(victim.mtx);
+			if (!victim.tasks.empty()) {
+				t = std::move(victim.tasks.back());
+				victim.tasks.pop_back();
+				--victim.queued;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/* True if a task is queued on a worker this one may take it from, itself or one on its node */
+	bool reachableWork(size_t workerIdx) {
+		int node = workers[workerIdx]->node;
+		for (const auto& w : workers) {
+			if (w->node == node && w->queued.load() > 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void workerLoop(size_t workerIdx) {
+
+		if (workers[workerIdx]->cpu >= 0) {
+			pinCurrentThread(workers[workerIdx]->cpu);
+		}
+
+		task t;
+
+		while (true) {
+
+			if (popLocal(workerIdx, t) || steal(workerIdx, t)) {
+				t(workerIdx);
+				t = nullptr;
+				if (--pending == 0) {
+					std::lock_guard<std::mutex> lock(sleepMtx);
+					doneCv.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMtx);
+			sleepCv.wait(lock, [this, workerIdx] { return stopping || reachableWork(workerIdx); });
+			if (stopping && !reachableWork(workerIdx)) {
+				return;
+			}
+
+		}
+
+	}
+
+};
+
+#endif // !THREADPOOL_H
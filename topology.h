@@ -0,0 +1,221 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/* Core types of hybrid processors, e.g. P-cores and E-cores of Alder Lake */
+enum coreKind { unknownCore = 0, performanceCore = 1, efficientCore = 2 };
+static constexpr size_t coreKinds = 3;
+
+inline const char* coreKindName(int kind) {
+	switch (kind) {
+	case performanceCore:
+		return "performance";
+	case efficientCore:
+		return "efficient";
+	default:
+		return "unknown";
+	}
+}
+
+/* A logical cpu, sibling is its index among the hyperthreads of its core */
+struct cpuInfo {
+	int cpu = 0;
+	int core = 0;
+	int package = 0;
+	int node = 0;
+	int sibling = 0;
+	int kind = unknownCore;
+};
+
+/* Parses a sysfs cpu list like 0-3,8-11 */
+inline std::vector<int> parseCpuList(const std::string& list) {
+	std::vector<int> cpus;
+	std::istringstream iss(list);
+	std::string range;
+	while (std::getline(iss, range, ',')) {
+		if (range.empty()) {
+			continue;
+		}
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+inline int readSysfsNumber(const std::string& path, int fallback) {
+	std::ifstream in(path);
+	int value;
+	return in >> value ? value : fallback;
+}
+
+/*
+* The cpus this process may run on with their core, package and NUMA node. Read from sysfs on Linux,
+* elsewhere every logical cpu is reported as its own core on node 0.
+*/
+inline std::vector<cpuInfo> readTopology() {
+
+	std::vector<cpuInfo> topology;
+
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	bool masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+	std::ifstream online("/sys/devices/system/cpu/online");
+	std::string list;
+	std::getline(online, list);
+
+	for (int cpu : parseCpuList(list)) {
+		if (masked && !CPU_ISSET(cpu, &allowed)) {
+			continue;
+		}
+		std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+		cpuInfo info;
+		info.cpu = cpu;
+		info.core = readSysfsNumber(base + "core_id", cpu);
+		info.package = readSysfsNumber(base + "physical_package_id", 0);
+		topology.push_back(info);
+	}
+
+	/* hybrid processors expose one PMU per core type */
+	const char* kindLists[] = { "", "/sys/devices/cpu_core/cpus", "/sys/devices/cpu_atom/cpus" };
+	for (int kind = performanceCore; kind <= efficientCore; ++kind) {
+		std::ifstream kindList(kindLists[kind]);
+		if (!std::getline(kindList, list)) {
+			continue;
+		}
+		for (int cpu : parseCpuList(list)) {
+			for (auto& info : topology) {
+				if (info.cpu == cpu) {
+					info.kind = kind;
+				}
+			}
+		}
+	}
+
+	for (int node = 0; node < 1024; ++node) {
+		std::ifstream nodeList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		if (!nodeList.is_open()) {
+			if (node > 0) {
+				break;
+			}
+			continue;
+		}
+		std::getline(nodeList, list);
+		for (int cpu : parseCpuList(list)) {
+			for (auto& info : topology) {
+				if (info.cpu == cpu) {
+					info.node = node;
+				}
+			}
+		}
+	}
+#endif
+
+	if (topology.empty()) {
+		unsigned cpus = std::thread::hardware_concurrency();
+		for (unsigned cpu = 0; cpu < (cpus ? cpus : 1); ++cpu) {
+			cpuInfo info;
+			info.cpu = static_cast<int>(cpu);
+			info.core = static_cast<int>(cpu);
+			topology.push_back(info);
+		}
+	}
+
+	std::sort(topology.begin(), topology.end(), [](const cpuInfo& a, const cpuInfo& b) {
+		if (a.node != b.node) return a.node < b.node;
+		if (a.package != b.package) return a.package < b.package;
+		if (a.core != b.core) return a.core < b.core;
+		return a.cpu < b.cpu;
+	});
+	for (size_t i = 1; i < topology.size(); ++i) {
+		const cpuInfo& previous = topology[i - 1];
+		if (topology[i].package == previous.package && topology[i].core == previous.core) {
+			topology[i].sibling = previous.sibling + 1;
+		}
+	}
+
+	return topology;
+}
+
+/*
+* Order in which workers are placed, grouped by node so consecutive workers share memory.
+* With avoidSmt the first hyperthread of every core comes before any second one.
+*/
+inline std::vector<cpuInfo> placementOrder(std::vector<cpuInfo> topology, bool avoidSmt) {
+	if (avoidSmt) {
+		std::stable_sort(topology.begin(), topology.end(), [](const cpuInfo& a, const cpuInfo& b) {
+			return a.sibling < b.sibling;
+		});
+	}
+	return topology;
+}
+
+/* Type of the core the calling thread runs on right now, from the hybrid leaf 0x1A of cpuid */
+inline int currentCoreKind() {
+
+	unsigned leaf7[4] = { 0, 0, 0, 0 };
+	unsigned leaf1A[4] = { 0, 0, 0, 0 };
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (!__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]) || !(leaf7[3] & (1u << 15))) {
+		return unknownCore;
+	}
+	__get_cpuid_count(0x1A, 0, &leaf1A[0], &leaf1A[1], &leaf1A[2], &leaf1A[3]);
+#elif defined(_M_X64)
+	int registers[4];
+	__cpuidex(registers, 7, 0);
+	if (!(registers[3] & (1 << 15))) {
+		return unknownCore;
+	}
+	__cpuidex(registers, 0x1A, 0);
+	leaf1A[0] = static_cast<unsigned>(registers[0]);
+#else
+	return unknownCore;
+#endif
+
+	switch (leaf1A[0] >> 24) {
+	case 0x40:
+		return performanceCore;
+	case 0x20:
+		return efficientCore;
+	default:
+		return unknownCore;
+	}
+}
+
+inline bool pinCurrentThread(int cpu) {
+#ifdef _WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+#endif // !TOPOLOGY_H
@@ -0,0 +1,223 @@
+#ifndef TRAILING_H
+#define TRAILING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/*
+* What is counted from the least significant bit: the run of bits equal to bit 0, the same run
+* after bit 0 is replaced by bit 1 (powers of five analysis) or the trailing zeroes.
+*/
+enum trailingKind { trailingRuns, trailingRunsPo5, trailingZeroes };
+
+/* Turns the counted run into trailing zeroes, so its length is a tzcnt, width for a full run */
+template<trailingKind kind, typename Bits>
+inline Bits trailingPrepare(Bits x) {
+	if constexpr (kind == trailingRunsPo5) {
+		x = (x & ~Bits(1)) | ((x >> 1) & Bits(1));
+	}
+	if constexpr (kind != trailingZeroes) {
+		x ^= Bits(0) - (x & Bits(1));
+	}
+	return x;
+}
+
+template<trailingKind kind, typename Bits>
+inline size_t trailingLength(Bits x) {
+	return static_cast<size_t>(std::countr_zero(trailingPrepare<kind>(x)));
+}
+
+#if defined(__AVX512F__) && defined(__AVX512CD__)
+/* tzcnt per lane as width - lzcnt of the mask below the lowest set bit, which is all ones for 0 */
+template<trailingKind kind>
+inline __m512i trailingLengths512(__m512i x) {
+	const __m512i one = _mm512_set1_epi32(1);
+	if constexpr (kind == trailingRunsPo5) {
+		x = _mm512_or_si512(_mm512_andnot_si512(one, x), _mm512_and_si512(_mm512_srli_epi32(x, 1), one));
+	}
+	if constexpr (kind != trailingZeroes) {
+		x = _mm512_xor_si512(x, _mm512_sub_epi32(_mm512_setzero_si512(), _mm512_and_si512(x, one)));
+	}
+	return _mm512_sub_epi32(_mm512_set1_epi32(32), _mm512_lzcnt_epi32(_mm512_andnot_si512(x, _mm512_sub_epi32(x, one))));
+}
+
+template<trailingKind kind>
+inline __m512i trailingLengths512x64(__m512i x) {
+	const __m512i one = _mm512_set1_epi64(1);
+	if constexpr (kind == trailingRunsPo5) {
+		x = _mm512_or_si512(_mm512_andnot_si512(one, x), _mm512_and_si512(_mm512_srli_epi64(x, 1), one));
+	}
+	if constexpr (kind != trailingZeroes) {
+		x = _mm512_xor_si512(x, _mm512_sub_epi64(_mm512_setzero_si512(), _mm512_and_si512(x, one)));
+	}
+	return _mm512_sub_epi64(_mm512_set1_epi64(64), _mm512_lzcnt_epi64(_mm512_andnot_si512(x, _mm512_sub_epi64(x, one))));
+}
+#elif defined(__AVX2__)
+/*
+* tzcnt of the eight 32 bit lanes: the lowest set bit converted to float is an exact power of two,
+* its exponent is the position. Lanes that are 0 get 32.
+*/
+inline __m256i trailingZeroes256(__m256i x) {
+	__m256i lowest = _mm256_and_si256(x, _mm256_sub_epi32(_mm256_setzero_si256(), x));
+	__m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(lowest)), 23);
+	exponent = _mm256_sub_epi32(_mm256_and_si256(exponent, _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(127));
+	return _mm256_blendv_epi8(exponent, _mm256_set1_epi32(32), _mm256_cmpeq_epi32(x, _mm256_setzero_si256()));
+}
+
+template<trailingKind kind>
+inline __m256i trailingLengths256(__m256i x) {
+	const __m256i one = _mm256_set1_epi32(1);
+	if constexpr (kind == trailingRunsPo5) {
+		x = _mm256_or_si256(_mm256_andnot_si256(one, x), _mm256_and_si256(_mm256_srli_epi32(x, 1), one));
+	}
+	if constexpr (kind != trailingZeroes) {
+		x = _mm256_xor_si256(x, _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(x, one)));
+	}
+	return trailingZeroes256(x);
+}
+
+/* 64 bit lanes from the two 32 bit halves: the high half only counts when the low one is 0 */
+template<trailingKind kind>
+inline __m256i trailingLengths256x64(__m256i x) {
+	const __m256i one = _mm256_set1_epi64x(1);
+	if constexpr (kind == trailingRunsPo5) {
+		x = _mm256_or_si256(_mm256_andnot_si256(one, x), _mm256_and_si256(_mm256_srli_epi64(x, 1), one));
+	}
+	if constexpr (kind != trailingZeroes) {
+		x = _mm256_xor_si256(x, _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(x, one)));
+	}
+	__m256i halves = trailingZeroes256(x);
+	__m256i lowFull = _mm256_cmpeq_epi64(_mm256_and_si256(halves, _mm256_set1_epi64x(0xFFFFFFFF)), _mm256_set1_epi64x(32));
+	__m256i high = _mm256_and_si256(_mm256_srli_epi64(halves, 32), lowFull);
+	return _mm256_and_si256(_mm256_add_epi64(halves, high), _mm256_set1_epi64x(0xFFFFFFFF));
+}
+#endif
+
+/* Writes the counted length of values[i] to lengths[i], 16 (AVX-512) or 8 (AVX2) values per step */
+template<trailingKind kind, typename Bits>
+inline void trailingLengths(const Bits* values, size_t n, uint8_t* lengths) {
+
+	size_t i = 0;
+
+#if defined(__AVX512F__) && defined(__AVX512CD__)
+	if constexpr (sizeof(Bits) == 4) {
+		for (; i + 16 <= n; i += 16) {
+			__m512i counted = trailingLengths512<kind>(_mm512_loadu_si512(values + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lengths + i), _mm512_cvtepi32_epi8(counted));
+		}
+	}
+	else {
+		for (; i + 8 <= n; i += 8) {
+			__m512i counted = trailingLengths512x64<kind>(_mm512_loadu_si512(values + i));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(lengths + i), _mm512_cvtepi64_epi8(counted));
+		}
+	}
+#elif defined(__AVX2__)
+	if constexpr (sizeof(Bits) == 4) {
+		for (; i + 8 <= n; i += 8) {
+			__m256i counted = trailingLengths256<kind>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+			__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(counted), _mm256_extracti128_si256(counted, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(lengths + i), _mm_packus_epi16(words, words));
+		}
+	}
+	else {
+		for (; i + 4 <= n; i += 4) {
+			__m256i counted = trailingLengths256x64<kind>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+			counted = _mm256_permutevar8x32_epi32(counted, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+			__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(counted), _mm256_castsi256_si128(counted));
+			uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+			std::memcpy(lengths + i, &packed, 4);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		lengths[i] = static_cast<uint8_t>(trailingLength<kind>(values[i]));
+	}
+}
+
+/*
+* Histogram of trailing lengths. Values are buffered and counted a block at a time into interleaved
+* uint16 sub-histograms, so consecutive equal lengths do not wait on the same counter, which are added
+* to the size_t target before they can overflow. flush has to be called before the target is read.
+*/
+template<trailingKind kind, typename Bits>
+class trailingHistogram {
+
+	static constexpr size_t width = sizeof(Bits) * 8;
+	static constexpr size_t blockSize = 256;
+	static constexpr size_t subHistograms = 4;
+	static constexpr size_t countLimit = 65535 * subHistograms;
+
+	std::vector<size_t>& target;
+	Bits buffer[blockSize];
+	uint8_t lengths[blockSize];
+	uint16_t counts[subHistograms][width + 1];
+	size_t buffered = 0;
+	size_t counted = 0;
+
+public:
+
+	explicit trailingHistogram(std::vector<size_t>& target) : target(target) {
+		std::memset(counts, 0, sizeof(counts));
+	}
+	trailingHistogram(const trailingHistogram&) = delete;
+	trailingHistogram& operator=(const trailingHistogram&) = delete;
+
+	void push(Bits value) {
+		buffer[buffered++] = value;
+		if (buffered == blockSize) {
+			countBuffered();
+		}
+	}
+
+	void flush() {
+		countBuffered();
+		addCounts();
+	}
+
+private:
+
+	void countBuffered() {
+
+		if (counted + blockSize > countLimit) {
+			addCounts();
+		}
+
+		trailingLengths<kind>(buffer, buffered, lengths);
+
+		size_t i = 0;
+		for (; i + subHistograms <= buffered; i += subHistograms) {
+			++counts[0][lengths[i]];
+			++counts[1][lengths[i + 1]];
+			++counts[2][lengths[i + 2]];
+			++counts[3][lengths[i + 3]];
+		}
+		for (; i < buffered; ++i) {
+			++counts[0][lengths[i]];
+		}
+
+		counted += buffered;
+		buffered = 0;
+	}
+
+	void addCounts() {
+		for (size_t s = 0; s < subHistograms; ++s) {
+			for (size_t l = 0; l <= width; ++l) {
+				target[l] += counts[s][l];
+			}
+		}
+		std::memset(counts, 0, sizeof(counts));
+		counted = 0;
+	}
+
+};
+
+#endif // !TRAILING_H